@@ -0,0 +1,160 @@
+// Headless benchmark: plays scenario files and gates on a stored baseline.
+//
+//   fire_bench <scenario file or directory> [-b baseline] [-t threshold] [-u]
+//
+// Without -u every result is compared with the baseline and the exit code
+// is 1 if any scenario lost more than threshold (default 0.15) of its
+// throughput or its p99 step time grew by more than that. -u records the
+// results as the new baseline instead. Exit code 2 means bad input.
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scenario.h"
+
+#define DEFAULT_THRESHOLD 0.15
+
+namespace {
+
+struct Baseline {
+    double throughput;
+    double p99StepMs;
+};
+
+std::map<std::string, Baseline> LoadBaseline(const std::string& file)
+{
+    std::map<std::string, Baseline> baseline;
+    std::ifstream stream(file);
+    std::string line;
+    while (std::getline(stream, line)) {
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string name;
+        Baseline entry;
+        if (tokens >> name >> entry.throughput >> entry.p99StepMs) {
+            baseline[name] = entry;
+        }
+    }
+    return baseline;
+}
+
+bool SaveBaseline(const std::string& file, const std::vector<ScenarioResult>& results)
+{
+    std::ofstream stream(file);
+    stream << "# scenario  particle updates/s  p99 step ms\n";
+    for (const auto& result : results) {
+        stream << result.name << " " << result.throughput << " " << result.p99StepMs << "\n";
+    }
+    return static_cast<bool>(stream);
+}
+
+int Usage()
+{
+    std::cout << "usage: fire_bench <scenario file or directory> [-b baseline] [-t threshold] [-u]"
+              << std::endl;
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string input;
+    std::string baselineFile;
+    double threshold = DEFAULT_THRESHOLD;
+    bool update = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-b" && i + 1 < argc)
+            baselineFile = argv[++i];
+        else if (arg == "-t" && i + 1 < argc)
+            threshold = std::atof(argv[++i]);
+        else if (arg == "-u")
+            update = true;
+        else if (input.empty() && arg[0] != '-')
+            input = arg;
+        else
+            return Usage();
+    }
+    if (input.empty() || (update && baselineFile.empty())) {
+        return Usage();
+    }
+
+    // 1. Scenario files, in name order so runs are comparable
+    std::vector<std::string> files;
+    std::error_code error;
+    if (std::filesystem::is_directory(input, error)) {
+        for (const auto& entry : std::filesystem::directory_iterator(input, error)) {
+            if (entry.path().extension() == ".scn") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(input);
+    }
+    if (files.empty()) {
+        std::cout << "ERROR::BENCH: no .scn files in " << input << std::endl;
+        return 2;
+    }
+
+    // 2. Run them
+    std::vector<ScenarioResult> results;
+    std::printf("%-24s %8s %14s %10s %10s\n", "scenario", "steps", "particles/s", "mean ms", "p99 ms");
+    for (const auto& file : files) {
+        Scenario scenario;
+        if (!Scenario::Load(file, scenario)) {
+            return 2;
+        }
+        results.push_back(RunScenario(scenario));
+        const ScenarioResult& result = results.back();
+        std::printf("%-24s %8zu %14.0f %10.3f %10.3f\n", result.name.c_str(), result.nSteps,
+                    result.throughput, result.meanStepMs, result.p99StepMs);
+    }
+
+    if (update) {
+        if (!SaveBaseline(baselineFile, results)) {
+            std::cout << "ERROR::BENCH: Failed to write baseline: " << baselineFile << std::endl;
+            return 2;
+        }
+        std::cout << "Baseline written to " << baselineFile << std::endl;
+        return 0;
+    }
+    if (baselineFile.empty()) {
+        return 0;
+    }
+
+    // 3. Gate on the baseline, scenarios it doesn't know yet pass
+    // timings are per machine, so no baseline is checked in
+    if (!std::ifstream(baselineFile)) {
+        std::cout << "ERROR::BENCH: No baseline at " << baselineFile
+                  << ", record one on this machine with make bench-baseline" << std::endl;
+        return 2;
+    }
+    const std::map<std::string, Baseline> baseline = LoadBaseline(baselineFile);
+    if (baseline.empty()) {
+        std::cout << "ERROR::BENCH: Failed to load baseline: " << baselineFile << std::endl;
+        return 2;
+    }
+    bool regressed = false;
+    for (const auto& result : results) {
+        const auto entry = baseline.find(result.name);
+        if (entry == baseline.end()) {
+            std::cout << result.name << ": not in baseline" << std::endl;
+            continue;
+        }
+        const double throughputChange = result.throughput / entry->second.throughput - 1.0;
+        const double p99Change = result.p99StepMs / entry->second.p99StepMs - 1.0;
+        const bool slower = throughputChange < -threshold || p99Change > threshold;
+        std::printf("%-24s throughput %+6.1f%%  p99 %+6.1f%%  %s\n", result.name.c_str(),
+                    throughputChange * 100.0, p99Change * 100.0, slower ? "REGRESSION" : "ok");
+        regressed = regressed || slower;
+    }
+    return regressed ? 1 : 0;
+}
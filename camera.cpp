@@ -82,3 +82,31 @@ void Camera::updateCameraVectors()
     m_right = glm::normalize(glm::cross(m_front, m_worldUp));
     m_up = glm::normalize(glm::cross(m_right, m_front));
 }
+
+Frustum::Frustum(const glm::mat4& m)
+{
+    // Gribb/Hartmann: row 3 plus or minus rows 0 to 2, glm is column major
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = 0; side < 2; ++side) {
+            const GLfloat sign = side == 0 ? 1.0f : -1.0f;
+            glm::vec4& plane = planes[2 * axis + side];
+            for (int column = 0; column < 4; ++column) {
+                plane[column] = m[column][3] + sign * m[column][axis];
+            }
+        }
+    }
+}
+
+bool Frustum::Intersects(const glm::vec3& min, const glm::vec3& max) const
+{
+    for (const glm::vec4& plane : planes) {
+        // the corner furthest along the normal
+        const glm::vec3 corner(plane.x > 0.0f ? max.x : min.x,
+                               plane.y > 0.0f ? max.y : min.y,
+                               plane.z > 0.0f ? max.z : min.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
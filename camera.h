@@ -33,6 +33,7 @@ class Camera {
         void ProcessMouseScroll(GLfloat yoffset);
 
         GLfloat GetZoom() const { return m_zoom; }
+        const glm::vec3& GetPosition() const { return m_position; }
 
     private:
         void updateCameraVectors();
@@ -51,3 +52,14 @@ class Camera {
 
         GLfloat m_zoom;
 };
+
+// View volume as six planes facing inwards, for culling bounding boxes
+struct Frustum {
+    // xyz normal, w offset
+    glm::vec4 planes[6];
+
+    // Planes of a projection * view matrix
+    explicit Frustum(const glm::mat4& viewProjection);
+    // False only if the box lies entirely outside one of the planes
+    bool Intersects(const glm::vec3& min, const glm::vec3& max) const;
+};
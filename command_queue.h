@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free queue for many producers and a single consumer, after
+// Vyukov's bounded MPMC queue. Every cell carries a sequence number that
+// tells producers whether the cell is free for their position and the
+// consumer whether it holds a value yet, so a push is one CAS on the tail
+// and a pop touches no shared counter at all. Pushing onto a full queue
+// fails instead of waiting
+template <typename T>
+class MpscQueue {
+public:
+    // capacity is rounded up to a power of two
+    explicit MpscQueue(size_t capacity)
+        : m_mask(RoundUp(capacity) - 1),
+          m_cells(new Cell[m_mask + 1]),
+          m_tail(0),
+          m_head(0)
+    {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    // Any thread. False if the queue is full
+    bool TryPush(const T& value)
+    {
+        size_t position = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = m_cells[position & m_mask];
+            const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                // the cell is free for this position, claim it
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // the consumer has not freed the cell of the last lap yet
+                return false;
+            } else {
+                // another producer took the position
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only. False if the queue is empty
+    bool TryPop(T& value)
+    {
+        Cell& cell = m_cells[m_head & m_mask];
+        if (cell.sequence.load(std::memory_order_acquire) != m_head + 1) {
+            return false;
+        }
+        value = cell.value;
+        // free for the producers of the next lap
+        cell.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+    size_t Capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t RoundUp(size_t n)
+    {
+        size_t capacity = 2;
+        while (capacity < n) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    const size_t m_mask;
+    const std::unique_ptr<Cell[]> m_cells;
+    // producers and the consumer on separate cache lines
+    alignas(64) std::atomic<size_t> m_tail;
+    alignas(64) size_t m_head;
+};
@@ -0,0 +1,195 @@
+#include "curl_noise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "thread_pool.h"
+
+namespace {
+
+// Quintic fade of classic Perlin noise
+GLfloat Fade(GLfloat t)
+{
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// Periodic gradient noise over a period^3 lattice of random unit gradients
+class GradientNoise {
+public:
+    GradientNoise(GLuint period, std::mt19937& rndGenerator)
+        : m_period(period)
+    {
+        std::normal_distribution<GLfloat> distribution(0.0f, 1.0f);
+        m_gradients.resize(static_cast<size_t>(period) * period * period);
+        for (auto& gradient : m_gradients) {
+            gradient = glm::normalize(glm::vec3(distribution(rndGenerator),
+                                                distribution(rndGenerator),
+                                                distribution(rndGenerator)));
+        }
+    }
+
+    GLfloat Evaluate(const glm::vec3& p) const
+    {
+        const glm::vec3 cell = glm::floor(p);
+        const glm::vec3 f = p - cell;
+        const int x0 = static_cast<int>(cell.x);
+        const int y0 = static_cast<int>(cell.y);
+        const int z0 = static_cast<int>(cell.z);
+
+        GLfloat corners[8];
+        for (int c = 0; c < 8; ++c) {
+            const glm::vec3 corner(c & 1, (c >> 1) & 1, (c >> 2) & 1);
+            const glm::vec3& gradient = Gradient(x0 + (c & 1), y0 + ((c >> 1) & 1), z0 + ((c >> 2) & 1));
+            corners[c] = glm::dot(gradient, f - corner);
+        }
+        const GLfloat u = Fade(f.x), v = Fade(f.y), w = Fade(f.z);
+        const GLfloat x00 = glm::mix(corners[0], corners[1], u);
+        const GLfloat x10 = glm::mix(corners[2], corners[3], u);
+        const GLfloat x01 = glm::mix(corners[4], corners[5], u);
+        const GLfloat x11 = glm::mix(corners[6], corners[7], u);
+        return glm::mix(glm::mix(x00, x10, v), glm::mix(x01, x11, v), w);
+    }
+
+private:
+    const glm::vec3& Gradient(int x, int y, int z) const
+    {
+        const int period = static_cast<int>(m_period);
+        // wrapping the lattice is what makes the volume tile
+        x = ((x % period) + period) % period;
+        y = ((y % period) + period) % period;
+        z = ((z % period) + period) % period;
+        return m_gradients[(static_cast<size_t>(z) * period + y) * period + x];
+    }
+
+    const GLuint m_period;
+    std::vector<glm::vec3> m_gradients;
+};
+
+// The wrapping masks need a power of two, others are rounded up to one
+GLuint CheckResolution(GLuint resolution)
+{
+    GLuint rounded = 1;
+    while (rounded < resolution && rounded < (1u << 31)) {
+        rounded <<= 1;
+    }
+    if (rounded != resolution) {
+        std::cout << "ERROR::CURL_NOISE: resolution " << resolution
+                  << " is no power of two, using " << rounded << std::endl;
+    }
+    return rounded;
+}
+
+} // namespace
+
+CurlNoise::Field::Field(const CurlNoiseParams& params, bool parallel)
+    : m_resolution(CheckResolution(params.resolution))
+{
+    const GLuint res = m_resolution;
+    const size_t nVoxels = static_cast<size_t>(res) * res * res;
+
+    std::mt19937 rndGenerator(params.seed);
+    const GradientNoise noise[3] = {GradientNoise(params.period, rndGenerator),
+                                    GradientNoise(params.period, rndGenerator),
+                                    GradientNoise(params.period, rndGenerator)};
+
+    auto forSlices = [parallel, res](auto&& job) {
+        if (parallel)
+            ThreadPool::Instance().ParallelFor(0, res, job);
+        else
+            job(0, res);
+    };
+
+    // 1. Vector potential, one noise per component
+    std::vector<glm::vec3> potential(nVoxels);
+    const GLfloat lattice = static_cast<GLfloat>(params.period) / res;
+    forSlices([&](size_t zBegin, size_t zEnd) {
+        for (GLuint z = zBegin; z < zEnd; ++z) {
+            for (GLuint y = 0; y < res; ++y) {
+                for (GLuint x = 0; x < res; ++x) {
+                    const glm::vec3 p = glm::vec3(x, y, z) * lattice;
+                    potential[Index(x, y, z)] = glm::vec3(noise[0].Evaluate(p),
+                                                          noise[1].Evaluate(p),
+                                                          noise[2].Evaluate(p));
+                }
+            }
+        }
+    });
+
+    // 2. Curl by wrapped central differences, divergence free by construction
+    m_velocity.resize(nVoxels);
+    const GLuint mask = res - 1;
+    forSlices([&](size_t zBegin, size_t zEnd) {
+        for (GLuint z = zBegin; z < zEnd; ++z) {
+            for (GLuint y = 0; y < res; ++y) {
+                for (GLuint x = 0; x < res; ++x) {
+                    const glm::vec3& px0 = potential[Index((x - 1) & mask, y, z)];
+                    const glm::vec3& px1 = potential[Index((x + 1) & mask, y, z)];
+                    const glm::vec3& py0 = potential[Index(x, (y - 1) & mask, z)];
+                    const glm::vec3& py1 = potential[Index(x, (y + 1) & mask, z)];
+                    const glm::vec3& pz0 = potential[Index(x, y, (z - 1) & mask)];
+                    const glm::vec3& pz1 = potential[Index(x, y, (z + 1) & mask)];
+                    m_velocity[Index(x, y, z)] = glm::vec3((py1.z - py0.z) - (pz1.y - pz0.y),
+                                                           (pz1.x - pz0.x) - (px1.z - px0.z),
+                                                           (px1.y - px0.y) - (py1.x - py0.x));
+                }
+            }
+        }
+    });
+
+    // 3. Scale to unit peak so amplitude is in world units per second
+    GLfloat peak = 0.0f;
+    for (const auto& velocity : m_velocity) {
+        peak = std::max(peak, glm::length(velocity));
+    }
+    if (peak > 0.0f) {
+        for (auto& velocity : m_velocity) {
+            velocity /= peak;
+        }
+    }
+}
+
+glm::vec3 CurlNoise::Field::Sample(const glm::vec3& position) const
+{
+    const glm::vec3 g = position * static_cast<GLfloat>(m_resolution);
+    const glm::vec3 cell = glm::floor(g);
+    const glm::vec3 t = g - cell;
+    const GLuint mask = m_resolution - 1;
+    // two's complement wrap handles negative cells as well
+    const GLuint x0 = static_cast<GLuint>(static_cast<int>(cell.x)) & mask;
+    const GLuint y0 = static_cast<GLuint>(static_cast<int>(cell.y)) & mask;
+    const GLuint z0 = static_cast<GLuint>(static_cast<int>(cell.z)) & mask;
+    const GLuint x1 = (x0 + 1) & mask;
+    const GLuint y1 = (y0 + 1) & mask;
+    const GLuint z1 = (z0 + 1) & mask;
+
+    const glm::vec3 c00 = glm::mix(m_velocity[Index(x0, y0, z0)], m_velocity[Index(x1, y0, z0)], t.x);
+    const glm::vec3 c10 = glm::mix(m_velocity[Index(x0, y1, z0)], m_velocity[Index(x1, y1, z0)], t.x);
+    const glm::vec3 c01 = glm::mix(m_velocity[Index(x0, y0, z1)], m_velocity[Index(x1, y0, z1)], t.x);
+    const glm::vec3 c11 = glm::mix(m_velocity[Index(x0, y1, z1)], m_velocity[Index(x1, y1, z1)], t.x);
+    return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+}
+
+CurlNoise::CurlNoise(const CurlNoiseParams& params)
+    : m_field(std::make_shared<const Field>(params, true))
+{
+}
+
+void CurlNoise::RebuildAsync(const CurlNoiseParams& params)
+{
+    // A rebuild already in flight is superseded, its result is dropped
+    m_pending = ThreadPool::Instance().Enqueue([params]() {
+        // Workers must not call ParallelFor, bake serially on this one
+        return std::shared_ptr<const Field>(std::make_shared<const Field>(params, false));
+    });
+}
+
+void CurlNoise::Poll()
+{
+    if (m_pending.valid() &&
+        m_pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        m_field = m_pending.get();
+    }
+}
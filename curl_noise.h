@@ -0,0 +1,76 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+
+// Baking parameters of a curl noise volume
+struct CurlNoiseParams {
+    // voxels per side, a power of two. Others are rounded up to one with
+    // an error
+    GLuint resolution = 32;
+    // noise lattice cells per side, the volume tiles seamlessly
+    GLuint period = 4;
+    uint32_t seed = 1;
+};
+
+// Tileable, divergence-free velocity volume obtained as the curl of a
+// periodic gradient noise potential. It is baked once (in parallel) so
+// that turbulence costs a single wrapped trilinear lookup per particle.
+class CurlNoise {
+public:
+    // Baked volume, immutable once published
+    class Field {
+    public:
+        Field(const CurlNoiseParams& params, bool parallel);
+        // Wrapped trilinear lookup, position is in tiles (1.0 = one period)
+        glm::vec3 Sample(const glm::vec3& position) const;
+
+    private:
+        size_t Index(GLuint x, GLuint y, GLuint z) const
+        {
+            return (static_cast<size_t>(z) * m_resolution + y) * m_resolution + x;
+        }
+
+        const GLuint m_resolution;
+        // unit peak magnitude
+        std::vector<glm::vec3> m_velocity;
+    };
+
+    // Bakes the initial volume on the thread pool
+    explicit CurlNoise(const CurlNoiseParams& params = CurlNoiseParams());
+
+    // Starts baking a new volume on a worker, the current one stays in use
+    // until Poll() picks up the result
+    void RebuildAsync(const CurlNoiseParams& params);
+    // Publishes a finished rebuild, call once per frame from the main thread
+    void Poll();
+
+    std::shared_ptr<const Field> GetField() const { return m_field; }
+
+private:
+    std::shared_ptr<const Field> m_field;
+    std::future<std::shared_ptr<const Field>> m_pending;
+};
+
+// Per-emitter view of a curl noise volume
+struct Turbulence {
+    std::shared_ptr<const CurlNoise::Field> field;
+    GLfloat amplitude = 0.0f;
+    // tiles per world unit
+    GLfloat frequency = 0.1f;
+    // offset scrolled over time, in tiles
+    glm::vec3 scroll = glm::vec3(0.0f);
+
+    glm::vec3 Sample(const glm::vec3& position) const
+    {
+        if (!field) {
+            return glm::vec3(0.0f);
+        }
+        return field->Sample(position * frequency + scroll) * amplitude;
+    }
+};
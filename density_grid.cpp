@@ -0,0 +1,757 @@
+#include "density_grid.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "thread_pool.h"
+
+// particles below this per chunk aren't worth another thread
+#define MIN_CHUNK_PARTICLES 4096
+
+// "FDEN", "FRAM" and "FIDX" in memory order
+#define DENSITY_FILE_MAGIC 0x4E454446u
+#define DENSITY_FRAME_MAGIC 0x4D415246u
+#define DENSITY_INDEX_MAGIC 0x58444946u
+#define DENSITY_FILE_VERSION 2u
+
+namespace {
+
+size_t Align(size_t size)
+{
+    return (size + 63) & ~static_cast<size_t>(63);
+}
+
+// Byte offsets of the parts of a frame of nBricks and nValues cells with
+// density, see density_grid.h
+struct FrameLayout {
+    size_t bricks;
+    size_t starts;
+    size_t masks;
+    size_t density;
+    size_t temperature;
+    size_t size;
+
+    FrameLayout(size_t nBricks, size_t nValues)
+    {
+        bricks = Align(sizeof(DensityFrameHeader));
+        starts = bricks + Align(sizeof(uint32_t) * nBricks);
+        masks = starts + Align(sizeof(uint32_t) * (nBricks + 1));
+        density = masks + sizeof(uint64_t) * DensityFrame::MASK_WORDS * nBricks;
+        temperature = density + Align(sizeof(uint16_t) * nValues);
+        size = temperature + Align(sizeof(uint16_t) * nValues);
+    }
+};
+
+// Half float of a value in [0, 1], rounded to nearest
+uint16_t PackHalf(GLfloat value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const int32_t exponent = static_cast<int32_t>(bits >> 23) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent <= 0) {
+        // denormal, mantissa * 2^-24
+        const int32_t shift = 14 - exponent;
+        if (shift > 24) {
+            return 0;
+        }
+        return static_cast<uint16_t>(((mantissa | 0x800000) + (1u << (shift - 1))) >> shift);
+    }
+    // a carry out of the mantissa moves on into the exponent
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+GLfloat UnpackHalf(uint16_t half)
+{
+    const uint32_t exponent = half >> 10;
+    const uint32_t mantissa = half & 0x3FF;
+    if (exponent == 0) {
+        return mantissa * (1.0f / 16777216.0f);
+    }
+    const uint32_t bits = ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    GLfloat value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// What DensityFile finds at a frame offset
+enum class FrameStatus { valid, truncated, corrupt };
+
+// Checks the frame at offset of a mapped file of size bytes against a grid
+// of nGridBricks, up to its brick ids, so it can be read without bounds
+// checks
+FrameStatus CheckFrame(const char* memory, size_t size, uint64_t offset, uint64_t nGridBricks)
+{
+    if (offset < Align(sizeof(DensityFileHeader)) || offset % 64 != 0) {
+        return FrameStatus::corrupt;
+    }
+    if (offset > size || size - offset < Align(sizeof(DensityFrameHeader))) {
+        return FrameStatus::truncated;
+    }
+    const DensityFrameHeader* header = reinterpret_cast<const DensityFrameHeader*>(memory + offset);
+    if (header->magic != DENSITY_FRAME_MAGIC || header->nBricks > nGridBricks ||
+        header->nValues > static_cast<uint64_t>(header->nBricks) * DensityGrid::BRICK_CELLS) {
+        return FrameStatus::corrupt;
+    }
+    const FrameLayout layout(header->nBricks, header->nValues);
+    if (header->bytes != layout.size) {
+        return FrameStatus::corrupt;
+    }
+    if (size - offset < header->bytes) {
+        return FrameStatus::truncated;
+    }
+
+    // Brick ids in the grid, and value ranges that add up to the masks
+    const char* base = memory + offset;
+    const uint32_t* bricks = reinterpret_cast<const uint32_t*>(base + layout.bricks);
+    const uint32_t* starts = reinterpret_cast<const uint32_t*>(base + layout.starts);
+    const uint64_t* masks = reinterpret_cast<const uint64_t*>(base + layout.masks);
+    if (starts[0] != 0 || starts[header->nBricks] != header->nValues) {
+        return FrameStatus::corrupt;
+    }
+    for (uint32_t i = 0; i < header->nBricks; ++i) {
+        uint32_t nSet = 0;
+        for (GLuint word = 0; word < DensityFrame::MASK_WORDS; ++word) {
+            nSet += __builtin_popcountll(masks[i * DensityFrame::MASK_WORDS + word]);
+        }
+        if (bricks[i] >= nGridBricks || starts[i] > starts[i + 1] ||
+            starts[i + 1] - starts[i] != nSet) {
+            return FrameStatus::corrupt;
+        }
+    }
+    return FrameStatus::valid;
+}
+
+bool Inside(const glm::ivec3& cell, const glm::ivec3& resolution)
+{
+    return cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < resolution.x &&
+           cell.y < resolution.y && cell.z < resolution.z;
+}
+
+} // namespace
+
+// DensityGrid {{{
+DensityGrid::DensityGrid(const glm::ivec3& resolution, GLfloat cellSize, const glm::vec3& origin)
+    : m_cellSize(cellSize),
+      m_origin(origin),
+      m_bricks((resolution + glm::ivec3(BRICK - 1)) / glm::ivec3(BRICK)),
+      m_nParticles(0),
+      m_nOutside(0)
+{
+    m_resolution = m_bricks * glm::ivec3(BRICK);
+    const size_t nBricks = static_cast<size_t>(m_bricks.x) * m_bricks.y * m_bricks.z;
+    m_slots.assign(nBricks, -1);
+    // one chunk per thread at most, see ThreadPool::ParallelFor
+    m_scratch.resize(ThreadPool::Instance().Size() + 1);
+    for (Scratch& scratch : m_scratch) {
+        scratch.slots.assign(nBricks, -1);
+    }
+}
+
+void DensityGrid::Splat(const EmitterManager& emitters)
+{
+    // 1. Every emitter's particles at its place in the flat arrays
+    std::vector<EmitterHandle> handles;
+    emitters.GetHandles(handles);
+    std::vector<size_t> firsts(handles.size() + 1, 0);
+    for (size_t i = 0; i < handles.size(); ++i) {
+        firsts[i + 1] = firsts[i] + emitters.Get(handles[i])->GetParticleCount();
+    }
+    const size_t n = firsts.back();
+    m_positions.resize(n);
+    m_colors.resize(n);
+    m_scales.resize(n);
+    m_layers.resize(n);
+    m_ages.resize(n);
+    m_masses.resize(n);
+    m_temperatures.resize(n);
+
+    // 2. Exported in parallel, world positions, masses and temperatures
+    ThreadPool::Instance().ParallelFor(0, handles.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Emitter* emitter = emitters.Get(handles[i]);
+            const size_t first = firsts[i];
+            const size_t count = emitter->Export(
+                m_positions.data() + first, m_colors.data() + first, m_scales.data() + first,
+                m_layers.data() + first, firsts[i + 1] - first, m_ages.data() + first);
+            for (size_t j = first; j < first + count; ++j) {
+                m_positions[j] += emitter->GetPosition();
+                m_masses[j] = m_colors[j].a * m_scales[j] * m_scales[j] * m_scales[j];
+                m_temperatures[j] = 1.0f - m_ages[j];
+            }
+            // stateless emitters export nothing
+            std::fill(m_masses.begin() + first + count, m_masses.begin() + firsts[i + 1], 0.0f);
+        }
+    });
+
+    Splat(m_positions.data(), m_masses.data(), m_temperatures.data(), n);
+}
+
+void DensityGrid::Splat(const glm::vec3* positions, const GLfloat* masses,
+                        const GLfloat* temperatures, size_t n)
+{
+    // 1. Contiguous chunks, every one into its own bricks
+    const size_t nChunks = std::max<size_t>(
+        1, std::min(m_scratch.size(), (n + MIN_CHUNK_PARTICLES - 1) / MIN_CHUNK_PARTICLES));
+    const size_t chunkSize = (n + nChunks - 1) / nChunks;
+    ThreadPool::Instance().ParallelFor(0, nChunks, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            const size_t first = std::min(chunk * chunkSize, n);
+            const size_t count = std::min(chunkSize, n - first);
+            SplatChunk(positions + first, masses + first, temperatures + first, count,
+                       m_scratch[chunk]);
+        }
+    });
+
+    // 2. Private bricks summed up
+    Reduce(nChunks);
+    m_nParticles = n;
+}
+
+void DensityGrid::SplatChunk(const glm::vec3* positions, const GLfloat* masses,
+                             const GLfloat* temperatures, size_t n, Scratch& scratch) const
+{
+    // 1. Particles sorted by the brick of their first corner, so the
+    // scatter below stays within one brick for a while instead of missing
+    // the cache on every corner
+    const GLfloat invCellSize = 1.0f / m_cellSize;
+    const GLfloat invCellVolume = invCellSize * invCellSize * invCellSize;
+    const glm::vec3 last(m_resolution - 1);
+    const GLuint nBricks = static_cast<GLuint>(scratch.slots.size());
+    scratch.keys.resize(n);
+    scratch.counts.assign(nBricks, 0);
+    for (size_t i = 0; i < n; ++i) {
+        const glm::vec3 g = (positions[i] - m_origin) * invCellSize - 0.5f;
+        // all eight corners inside of the grid, and something to add
+        if (masses[i] <= 0.0f || g.x < 0.0f || g.y < 0.0f || g.z < 0.0f || g.x >= last.x ||
+            g.y >= last.y || g.z >= last.z) {
+            scratch.nOutside += masses[i] > 0.0f;
+            scratch.keys[i] = nBricks;
+            continue;
+        }
+        scratch.keys[i] = BrickIndex(glm::ivec3(g) / static_cast<int>(BRICK));
+        ++scratch.counts[scratch.keys[i]];
+    }
+    GLuint first = 0;
+    for (GLuint brick = 0; brick < nBricks; ++brick) {
+        const GLuint count = scratch.counts[brick];
+        scratch.counts[brick] = first;
+        first += count;
+    }
+    scratch.points.resize(first);
+    for (size_t i = 0; i < n; ++i) {
+        const GLuint brick = scratch.keys[i];
+        if (brick < nBricks) {
+            const glm::vec3 corner(BrickCoordinates(brick) * static_cast<int>(BRICK));
+            scratch.points[scratch.counts[brick]++] = {
+                (positions[i] - m_origin) * invCellSize - 0.5f - corner, masses[i] * invCellVolume,
+                temperatures[i], brick};
+        }
+    }
+
+    // 2. Every particle onto the eight cell centers around it, all of them
+    // within the private brick thanks to its apron
+    GLuint brick = nBricks;
+    GLfloat* density = nullptr;
+    GLfloat* temperature = nullptr;
+    for (const Point& point : scratch.points) {
+        if (point.brick != brick) {
+            brick = point.brick;
+            const size_t offset = PrivateBrick(scratch, brick);
+            density = &scratch.density[offset];
+            temperature = &scratch.temperature[offset];
+        }
+        const glm::vec3 base = glm::floor(point.position);
+        const glm::uvec3 cell(base);
+        const glm::vec3 f = point.position - base;
+        const GLfloat wx[2] = {1.0f - f.x, f.x};
+        const GLfloat wy[2] = {1.0f - f.y, f.y};
+        const GLfloat wz[2] = {point.density * (1.0f - f.z), point.density * f.z};
+        const size_t corner = (cell.z * APRON + cell.y) * APRON + cell.x;
+        for (GLuint z = 0; z < 2; ++z) {
+            for (GLuint y = 0; y < 2; ++y) {
+                const size_t row = corner + (z * APRON + y) * APRON;
+                const GLfloat w0 = wz[z] * wy[y] * wx[0];
+                const GLfloat w1 = wz[z] * wy[y] * wx[1];
+                density[row] += w0;
+                density[row + 1] += w1;
+                temperature[row] += w0 * point.temperature;
+                temperature[row + 1] += w1 * point.temperature;
+            }
+        }
+    }
+}
+
+size_t DensityGrid::PrivateBrick(Scratch& scratch, GLuint brick) const
+{
+    int32_t& slot = scratch.slots[brick];
+    if (slot < 0) {
+        slot = static_cast<int32_t>(scratch.bricks.size());
+        scratch.bricks.push_back(brick);
+        scratch.density.resize(scratch.density.size() + APRON_CELLS, 0.0f);
+        scratch.temperature.resize(scratch.temperature.size() + APRON_CELLS, 0.0f);
+    }
+    return static_cast<size_t>(slot) * APRON_CELLS;
+}
+
+void DensityGrid::Reduce(size_t nChunks)
+{
+    // 1. The bricks reached by any chunk and the ones their aprons
+    // reach, ascending
+    for (const GLuint brick : m_active) {
+        m_slots[brick] = -1;
+    }
+    m_active.clear();
+    for (size_t chunk = 0; chunk < nChunks; ++chunk) {
+        for (const GLuint brick : m_scratch[chunk].bricks) {
+            for (GLuint apron = 0; apron < 8; ++apron) {
+                const glm::ivec3 step(apron & 1, (apron >> 1) & 1, (apron >> 2) & 1);
+                const glm::ivec3 neighbour = BrickCoordinates(brick) + step;
+                if (!Inside(neighbour, m_bricks)) {
+                    continue;
+                }
+                const GLuint index = BrickIndex(neighbour);
+                if (m_slots[index] < 0) {
+                    m_slots[index] = 0;
+                    m_active.push_back(index);
+                }
+            }
+        }
+    }
+    std::sort(m_active.begin(), m_active.end());
+    m_density.resize(m_active.size() * BRICK_CELLS);
+    m_temperature.resize(m_active.size() * BRICK_CELLS);
+
+    // 2. Every brick summed by one thread from the private copies of its
+    // own and of the aprons of the bricks below, the temperature turned
+    // into the weighted mean
+    std::vector<uint8_t> empty(m_active.size());
+    ThreadPool::Instance().ParallelFor(0, m_active.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GLfloat* density = &m_density[i * BRICK_CELLS];
+            GLfloat* temperature = &m_temperature[i * BRICK_CELLS];
+            std::fill(density, density + BRICK_CELLS, 0.0f);
+            std::fill(temperature, temperature + BRICK_CELLS, 0.0f);
+            const glm::ivec3 b = BrickCoordinates(m_active[i]);
+            for (GLuint apron = 0; apron < 8; ++apron) {
+                // o of 1 takes the single layer of the apron of the brick
+                // below on that axis
+                const glm::ivec3 o(apron & 1, (apron >> 1) & 1, (apron >> 2) & 1);
+                const glm::ivec3 source = b - o;
+                if (!Inside(source, m_bricks)) {
+                    continue;
+                }
+                const GLuint sourceIndex = BrickIndex(source);
+                const glm::ivec3 end = glm::ivec3(BRICK) - glm::ivec3(BRICK - 1) * o;
+                for (size_t chunk = 0; chunk < nChunks; ++chunk) {
+                    const Scratch& scratch = m_scratch[chunk];
+                    const int32_t slot = scratch.slots[sourceIndex];
+                    if (slot < 0) {
+                        continue;
+                    }
+                    const size_t offset = static_cast<size_t>(slot) * APRON_CELLS;
+                    for (int z = 0; z < end.z; ++z) {
+                        for (int y = 0; y < end.y; ++y) {
+                            const size_t to = (z * BRICK + y) * BRICK;
+                            const size_t from =
+                                offset + ((z + BRICK * o.z) * APRON + y + BRICK * o.y) * APRON +
+                                BRICK * o.x;
+                            for (int x = 0; x < end.x; ++x) {
+                                density[to + x] += scratch.density[from + x];
+                                temperature[to + x] += scratch.temperature[from + x];
+                            }
+                        }
+                    }
+                }
+            }
+            empty[i] = 1;
+            for (GLuint cell = 0; cell < BRICK_CELLS; ++cell) {
+                if (density[cell] > 0.0f) {
+                    temperature[cell] /= density[cell];
+                    empty[i] = 0;
+                }
+            }
+        }
+    });
+
+    // 3. Bricks only reached by an empty part of an apron dropped
+    size_t nActive = 0;
+    for (size_t i = 0; i < m_active.size(); ++i) {
+        if (empty[i]) {
+            m_slots[m_active[i]] = -1;
+            continue;
+        }
+        if (nActive != i) {
+            m_active[nActive] = m_active[i];
+            std::copy_n(&m_density[i * BRICK_CELLS], BRICK_CELLS,
+                        &m_density[nActive * BRICK_CELLS]);
+            std::copy_n(&m_temperature[i * BRICK_CELLS], BRICK_CELLS,
+                        &m_temperature[nActive * BRICK_CELLS]);
+        }
+        m_slots[m_active[nActive]] = static_cast<int32_t>(nActive);
+        ++nActive;
+    }
+    m_active.resize(nActive);
+    m_density.resize(nActive * BRICK_CELLS);
+    m_temperature.resize(nActive * BRICK_CELLS);
+
+    // 4. Private bricks emptied for the next splat
+    m_nOutside = 0;
+    for (size_t chunk = 0; chunk < nChunks; ++chunk) {
+        Scratch& scratch = m_scratch[chunk];
+        for (const GLuint brick : scratch.bricks) {
+            scratch.slots[brick] = -1;
+        }
+        scratch.bricks.clear();
+        scratch.density.clear();
+        scratch.temperature.clear();
+        m_nOutside += scratch.nOutside;
+        scratch.nOutside = 0;
+    }
+}
+
+int64_t DensityGrid::Locate(const glm::ivec3& cell) const
+{
+    if (!Inside(cell, m_resolution)) {
+        return -1;
+    }
+    const glm::uvec3 u(cell);
+    const GLuint brick = BrickIndex(glm::ivec3(u / BRICK));
+    if (m_slots[brick] < 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(m_slots[brick]) * BRICK_CELLS +
+           ((u.z % BRICK) * BRICK + u.y % BRICK) * BRICK + u.x % BRICK;
+}
+
+GLfloat DensityGrid::GetDensity(const glm::ivec3& cell) const
+{
+    const int64_t index = Locate(cell);
+    return index < 0 ? 0.0f : m_density[index];
+}
+
+GLfloat DensityGrid::GetTemperature(const glm::ivec3& cell) const
+{
+    const int64_t index = Locate(cell);
+    return index < 0 ? 0.0f : m_temperature[index];
+}
+// }}}
+
+// DensityWriter {{{
+DensityWriter::DensityWriter()
+    : m_hasPending(false),
+      m_stop(false),
+      m_nFrames(0),
+      m_nBytes(0),
+      m_time(0.0f)
+{
+    m_thread = std::thread(&DensityWriter::WriterLoop, this);
+}
+
+DensityWriter::~DensityWriter()
+{
+    Close();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    m_thread.join();
+}
+
+void DensityWriter::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_condition.wait(lock, [this]() { return m_stop || m_hasPending; });
+        if (m_stop) {
+            return;
+        }
+        // Write only touches m_frame meanwhile
+        lock.unlock();
+        m_stream.write(m_pending.data(), m_pending.size());
+        lock.lock();
+        m_hasPending = false;
+        m_condition.notify_all();
+    }
+}
+
+void DensityWriter::WaitForWrite()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_condition.wait(lock, [this]() { return !m_hasPending; });
+}
+
+bool DensityWriter::Open(const std::string& path, const DensityGrid& grid)
+{
+    Close();
+    m_stream.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_stream) {
+        std::cout << "ERROR::DENSITY: Failed to write density file: " << path << std::endl;
+        return false;
+    }
+    m_path = path;
+    m_offsets.clear();
+    m_nFrames = 0;
+    m_time = 0.0f;
+
+    std::vector<char> header(Align(sizeof(DensityFileHeader)), 0);
+    const DensityFileHeader fileHeader = {DENSITY_FILE_MAGIC, DENSITY_FILE_VERSION,
+                                          grid.GetResolution(), DensityGrid::BRICK,
+                                          grid.GetCellSize(), grid.GetOrigin()};
+    std::memcpy(header.data(), &fileHeader, sizeof(fileHeader));
+    m_stream.write(header.data(), header.size());
+    m_nBytes = header.size();
+    return true;
+}
+
+void DensityWriter::Write(const DensityGrid& grid, GLfloat dt)
+{
+    if (!m_stream.is_open()) {
+        return;
+    }
+    // 1. Cells with density and the largest density per brick
+    const std::vector<GLuint>& active = grid.GetActiveBricks();
+    const size_t nBricks = active.size();
+    const GLuint nCells = DensityGrid::BRICK_CELLS;
+    m_time = m_nFrames == 0 ? 0.0f : m_time + dt;
+    m_counts.resize(nBricks + 1);
+    m_maxima.resize(nBricks);
+    ThreadPool::Instance().ParallelFor(0, nBricks, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const GLfloat* density = grid.GetDensity(i);
+            uint32_t count = 0;
+            GLfloat maximum = 0.0f;
+            for (GLuint c = 0; c < nCells; ++c) {
+                count += density[c] > 0.0f;
+                maximum = std::max(maximum, density[c]);
+            }
+            m_counts[i] = count;
+            m_maxima[i] = maximum;
+        }
+    });
+
+    // 2. Value ranges of the bricks, in place of the counts
+    uint32_t nValues = 0;
+    for (size_t i = 0; i <= nBricks; ++i) {
+        const uint32_t count = i < nBricks ? m_counts[i] : 0;
+        m_counts[i] = nValues;
+        nValues += count;
+    }
+    const GLfloat maxDensity =
+        nBricks > 0 ? *std::max_element(m_maxima.begin(), m_maxima.end()) : 0.0f;
+    const FrameLayout layout(nBricks, nValues);
+    const DensityFrameHeader header = {DENSITY_FRAME_MAGIC, static_cast<uint32_t>(nBricks), m_nFrames,
+                                       m_time, maxDensity, layout.size, nValues, 0};
+    m_frame.assign(layout.size, 0);
+    std::memcpy(m_frame.data(), &header, sizeof(header));
+    std::memcpy(&m_frame[layout.bricks], active.data(), sizeof(uint32_t) * nBricks);
+    std::memcpy(&m_frame[layout.starts], m_counts.data(), sizeof(uint32_t) * (nBricks + 1));
+
+    // 3. Masks and quantized values, every brick into its own range
+    uint64_t* masks = reinterpret_cast<uint64_t*>(&m_frame[layout.masks]);
+    uint16_t* densities = reinterpret_cast<uint16_t*>(&m_frame[layout.density]);
+    uint16_t* temperatures = reinterpret_cast<uint16_t*>(&m_frame[layout.temperature]);
+    const GLfloat scale = maxDensity > 0.0f ? 1.0f / maxDensity : 0.0f;
+    ThreadPool::Instance().ParallelFor(0, nBricks, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const GLfloat* density = grid.GetDensity(i);
+            const GLfloat* temperature = grid.GetTemperature(i);
+            uint64_t* mask = masks + i * DensityFrame::MASK_WORDS;
+            uint32_t value = m_counts[i];
+            for (GLuint c = 0; c < nCells; ++c) {
+                if (density[c] > 0.0f) {
+                    mask[c / 64] |= uint64_t(1) << (c % 64);
+                    densities[value] = PackHalf(std::min(density[c] * scale, 1.0f));
+                    temperatures[value] = static_cast<uint16_t>(
+                        glm::clamp(temperature[c], 0.0f, 1.0f) * 65535.0f + 0.5f);
+                    ++value;
+                }
+            }
+        }
+    });
+
+    // 4. Written while the next frame simulates. A thread of its own, so
+    // the disk never holds up the pool
+    WaitForWrite();
+    std::swap(m_frame, m_pending);
+    m_offsets.push_back(m_nBytes);
+    m_nBytes += layout.size;
+    ++m_nFrames;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hasPending = true;
+    }
+    m_condition.notify_all();
+}
+
+void DensityWriter::Close()
+{
+    if (!m_stream.is_open()) {
+        return;
+    }
+    WaitForWrite();
+    const DensityFileIndex index = {m_nFrames, m_nBytes, DENSITY_INDEX_MAGIC, 0};
+    m_stream.write(reinterpret_cast<const char*>(m_offsets.data()),
+                   sizeof(uint64_t) * m_offsets.size());
+    m_stream.write(reinterpret_cast<const char*>(&index), sizeof(index));
+    m_stream.close();
+    if (!m_stream) {
+        std::cout << "ERROR::DENSITY: Failed to write density file: " << m_path << std::endl;
+    }
+}
+// }}}
+
+// DensityFile {{{
+DensityFile::DensityFile()
+    : m_memory(nullptr),
+      m_size(0),
+      m_header(nullptr)
+{
+}
+
+DensityFile::~DensityFile()
+{
+    Close();
+}
+
+void DensityFile::Close()
+{
+    if (m_memory) {
+        munmap(const_cast<char*>(m_memory), m_size);
+    }
+    m_memory = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_frames.clear();
+}
+
+bool DensityFile::Open(const std::string& path)
+{
+    Close();
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cout << "Failed to load density file at path: " << path << std::endl;
+        return false;
+    }
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &status) == 0 &&
+        static_cast<size_t>(status.st_size) >= Align(sizeof(DensityFileHeader))) {
+        memory = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::cout << "ERROR::DENSITY: Failed to map density file: " << path << std::endl;
+        return false;
+    }
+    m_memory = static_cast<const char*>(memory);
+    m_size = status.st_size;
+    m_header = reinterpret_cast<const DensityFileHeader*>(m_memory);
+    if (m_header->magic != DENSITY_FILE_MAGIC || m_header->version != DENSITY_FILE_VERSION ||
+        m_header->brick != DensityGrid::BRICK) {
+        std::cout << "ERROR::DENSITY: Not a density file of this version: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    // 1. The grid the brick ids index, written in whole bricks
+    const glm::ivec3& resolution = m_header->resolution;
+    const GLint brick = DensityGrid::BRICK;
+    if (resolution.x <= 0 || resolution.y <= 0 || resolution.z <= 0 || resolution.x % brick != 0 ||
+        resolution.y % brick != 0 || resolution.z % brick != 0) {
+        return Reject(path);
+    }
+    const uint64_t nGridBricks = static_cast<uint64_t>(resolution.x / brick) *
+                                 (resolution.y / brick) * (resolution.z / brick);
+
+    // 2. The index of a closed file, all frames it lists have to be intact.
+    // Closed files end 8 byte aligned, cut off ones may not
+    if (m_size >= Align(sizeof(DensityFileHeader)) + sizeof(DensityFileIndex) &&
+        m_size % sizeof(uint64_t) == 0) {
+        const size_t end = m_size - sizeof(DensityFileIndex);
+        const DensityFileIndex* index = reinterpret_cast<const DensityFileIndex*>(m_memory + end);
+        if (index->magic == DENSITY_INDEX_MAGIC && index->offset <= end &&
+            index->offset % sizeof(uint64_t) == 0 &&
+            (end - index->offset) / sizeof(uint64_t) == index->nFrames &&
+            (end - index->offset) % sizeof(uint64_t) == 0) {
+            const uint64_t* offsets = reinterpret_cast<const uint64_t*>(m_memory + index->offset);
+            m_frames.assign(offsets, offsets + index->nFrames);
+            for (uint64_t offset : m_frames) {
+                // frames end where the index starts
+                if (CheckFrame(m_memory, index->offset, offset, nGridBricks) != FrameStatus::valid) {
+                    return Reject(path);
+                }
+            }
+            return true;
+        }
+    }
+
+    // 3. Otherwise every complete frame from the start
+    size_t offset = Align(sizeof(DensityFileHeader));
+    while (offset < m_size) {
+        const FrameStatus status = CheckFrame(m_memory, m_size, offset, nGridBricks);
+        if (status == FrameStatus::truncated) {
+            break;
+        }
+        if (status == FrameStatus::corrupt) {
+            return Reject(path);
+        }
+        m_frames.push_back(offset);
+        offset += reinterpret_cast<const DensityFrameHeader*>(m_memory + offset)->bytes;
+    }
+    return true;
+}
+
+bool DensityFile::Reject(const std::string& path)
+{
+    std::cout << "ERROR::DENSITY: Corrupt density file: " << path << std::endl;
+    Close();
+    return false;
+}
+
+DensityFrame DensityFile::GetFrame(size_t i) const
+{
+    const char* base = m_memory + m_frames[i];
+    const DensityFrameHeader* header = reinterpret_cast<const DensityFrameHeader*>(base);
+    const FrameLayout layout(header->nBricks, header->nValues);
+    DensityFrame frame;
+    frame.frame = header->frame;
+    frame.time = header->time;
+    frame.maxDensity = header->maxDensity;
+    frame.nBricks = header->nBricks;
+    frame.bricks = reinterpret_cast<const uint32_t*>(base + layout.bricks);
+    frame.starts = reinterpret_cast<const uint32_t*>(base + layout.starts);
+    frame.masks = reinterpret_cast<const uint64_t*>(base + layout.masks);
+    frame.density = reinterpret_cast<const uint16_t*>(base + layout.density);
+    frame.temperature = reinterpret_cast<const uint16_t*>(base + layout.temperature);
+    return frame;
+}
+
+void DensityFrame::Decode(size_t i, GLfloat* density, GLfloat* temperature) const
+{
+    const uint64_t* mask = masks + i * MASK_WORDS;
+    uint32_t value = starts[i];
+    for (GLuint c = 0; c < DensityGrid::BRICK_CELLS; ++c) {
+        if (mask[c / 64] >> (c % 64) & 1) {
+            density[c] = UnpackHalf(this->density[value]) * maxDensity;
+            temperature[c] = this->temperature[value] * (1.0f / 65535.0f);
+            ++value;
+        } else {
+            density[c] = 0.0f;
+            temperature[c] = 0.0f;
+        }
+    }
+}
+// }}}
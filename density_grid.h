@@ -0,0 +1,286 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emitter_manager.h"
+
+// Density and temperature of the particles on a regular grid, for offline
+// volume renderers and analytics. Every live particle adds its mass,
+// alpha times scale cubed, to the eight cell centers around it with
+// trilinear weights. Temperature is 1 at birth and 0 at death, the cells
+// hold the density weighted mean.
+//
+// Cells are stored in bricks of BRICK^3, and only bricks reached by a
+// particle exist. Splat scatters in chunks of particles across the thread
+// pool, every chunk into private copies of the bricks it reaches, then
+// sums the copies brick by brick. No two threads ever write the same
+// memory, so there are no atomics. Particles closer than half a cell to
+// the faces of the grid are left out
+class DensityGrid {
+public:
+    static const GLuint BRICK = 16;
+    static const GLuint BRICK_CELLS = BRICK * BRICK * BRICK;
+
+    // resolution is rounded up to whole bricks
+    DensityGrid(const glm::ivec3& resolution, GLfloat cellSize, const glm::vec3& origin);
+
+    DensityGrid(const DensityGrid&) = delete;
+    DensityGrid& operator=(const DensityGrid&) = delete;
+
+    // Replaces the grid by the live particles of all emitters, no emitter
+    // may update meanwhile. Not to be called from a ThreadPool worker
+    void Splat(const EmitterManager& emitters);
+    // Same for n particles in world space
+    void Splat(const glm::vec3* positions, const GLfloat* masses, const GLfloat* temperatures,
+               size_t n);
+
+    const glm::ivec3& GetResolution() const { return m_resolution; }
+    GLfloat GetCellSize() const { return m_cellSize; }
+    const glm::vec3& GetOrigin() const { return m_origin; }
+    // Bricks per axis
+    const glm::ivec3& GetBricks() const { return m_bricks; }
+
+    // Indices of the bricks holding particles, ascending. Brick b covers
+    // the cells from BRICK * (b % x, b / x % y, b / (x * y))
+    const std::vector<GLuint>& GetActiveBricks() const { return m_active; }
+    // BRICK_CELLS x-major cells of the i-th active brick, the bricks follow
+    // each other
+    const GLfloat* GetDensity(size_t i) const { return &m_density[i * BRICK_CELLS]; }
+    const GLfloat* GetTemperature(size_t i) const { return &m_temperature[i * BRICK_CELLS]; }
+    // Cell lookup, 0 outside of the active bricks
+    GLfloat GetDensity(const glm::ivec3& cell) const;
+    GLfloat GetTemperature(const glm::ivec3& cell) const;
+
+    // particles of the last Splat and those of them outside of the grid
+    size_t GetParticleCount() const { return m_nParticles; }
+    size_t GetOutsideCount() const { return m_nOutside; }
+
+private:
+    // Private bricks have an apron of one cell on their upper faces, so
+    // all corners of a particle land in the brick of its first corner
+    static const GLuint APRON = BRICK + 1;
+    static const GLuint APRON_CELLS = APRON * APRON * APRON;
+
+    // A particle of a chunk, sorted by brick
+    struct Point {
+        // grid coordinates within the brick, cell centers at integers
+        glm::vec3 position;
+        GLfloat density;
+        GLfloat temperature;
+        GLuint brick;
+    };
+
+    // Private bricks of one chunk of particles
+    struct Scratch {
+        // the chunk's particles sorted by the brick of their first corner,
+        // through the particle counts per brick
+        std::vector<GLuint> keys;
+        std::vector<GLuint> counts;
+        std::vector<Point> points;
+        // per brick of the grid, the private copy or -1
+        std::vector<int32_t> slots;
+        // bricks with a private copy, in the order they were reached
+        std::vector<GLuint> bricks;
+        std::vector<GLfloat> density;
+        std::vector<GLfloat> temperature;
+        size_t nOutside = 0;
+    };
+
+    void SplatChunk(const glm::vec3* positions, const GLfloat* masses,
+                    const GLfloat* temperatures, size_t n, Scratch& scratch) const;
+    // Index of the brick at brick coordinates b and back
+    GLuint BrickIndex(const glm::ivec3& b) const
+    {
+        return (b.z * m_bricks.y + b.y) * m_bricks.x + b.x;
+    }
+    glm::ivec3 BrickCoordinates(GLuint brick) const
+    {
+        return glm::ivec3(brick % m_bricks.x, brick / m_bricks.x % m_bricks.y,
+                          brick / (m_bricks.x * m_bricks.y));
+    }
+    // First cell of the chunk's copy of brick, created on first use
+    size_t PrivateBrick(Scratch& scratch, GLuint brick) const;
+    // Sums the private copies into the active bricks
+    void Reduce(size_t nChunks);
+    // Active brick slot and cell offset of a cell, -1 if not active
+    int64_t Locate(const glm::ivec3& cell) const;
+
+    glm::ivec3 m_resolution;
+    GLfloat m_cellSize;
+    glm::vec3 m_origin;
+    glm::ivec3 m_bricks;
+
+    std::vector<GLuint> m_active;
+    // per brick of the grid, its index in m_active or -1
+    std::vector<int32_t> m_slots;
+    std::vector<GLfloat> m_density;
+    std::vector<GLfloat> m_temperature;
+    std::vector<Scratch> m_scratch;
+    size_t m_nParticles;
+    size_t m_nOutside;
+
+    // particles of all emitters, scratch of Splat(const EmitterManager&)
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::vec4> m_colors;
+    std::vector<GLfloat> m_scales;
+    std::vector<GLuint> m_layers;
+    std::vector<GLfloat> m_ages;
+    std::vector<GLfloat> m_masses;
+    std::vector<GLfloat> m_temperatures;
+};
+
+// Density files: a DensityFileHeader, then the frames one after another,
+// then a frame index once the file was closed. Only the active bricks of
+// a frame are stored, and in those only the cells holding particles,
+// which is what keeps the files small since fire fills a fraction of its
+// grid and of its bricks. A frame is a DensityFrameHeader, then every
+// part 64 byte aligned:
+// - the ids of its active bricks
+// - per brick the index of its first value, and the value count at the end
+// - per brick a mask of BRICK_CELLS bits, set for the cells with density
+// - the densities of the set cells, brick by brick in cell order, as half
+//   floats relative to the frame's maxDensity
+// - their temperatures, 16 bit fixed point in [0, 1]
+// A mapped file is decoded in place, one brick at a time
+
+struct DensityFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    glm::ivec3 resolution;
+    uint32_t brick;
+    GLfloat cellSize;
+    glm::vec3 origin;
+};
+
+struct DensityFrameHeader {
+    uint32_t magic;
+    uint32_t nBricks;
+    uint64_t frame;
+    // seconds since the first frame
+    GLfloat time;
+    GLfloat maxDensity;
+    // of the whole frame, header included
+    uint64_t bytes;
+    // cells with density, over all bricks
+    uint32_t nValues;
+    uint32_t padding;
+};
+
+// Follows the index at the very end of a closed file
+struct DensityFileIndex {
+    uint64_t nFrames;
+    // file offset of nFrames uint64_t frame offsets
+    uint64_t offset;
+    uint32_t magic;
+    uint32_t padding;
+};
+
+// A frame as mapped by DensityFile, valid while the file is open
+struct DensityFrame {
+    static const GLuint MASK_WORDS = DensityGrid::BRICK_CELLS / 64;
+
+    uint64_t frame;
+    GLfloat time;
+    GLfloat maxDensity;
+    uint32_t nBricks;
+    const uint32_t* bricks;
+    // nBricks + 1 value indices
+    const uint32_t* starts;
+    // MASK_WORDS per brick, cell c is bit c % 64 of word c / 64
+    const uint64_t* masks;
+    const uint16_t* density;
+    const uint16_t* temperature;
+
+    // Decodes the i-th brick into BRICK_CELLS x-major cells each
+    void Decode(size_t i, GLfloat* density, GLfloat* temperature) const;
+};
+
+// Streams the frames of a DensityGrid to a density file. Write encodes the
+// active bricks on the thread pool and hands them to the writer's own
+// thread, which lives as long as the writer, so a frame only waits for
+// the write of the frame before
+class DensityWriter {
+public:
+    // Starts the writer thread
+    DensityWriter();
+    // Closes the file and joins the writer thread
+    ~DensityWriter();
+
+    DensityWriter(const DensityWriter&) = delete;
+    DensityWriter& operator=(const DensityWriter&) = delete;
+
+    // Prints an error and returns false if the file can't be written
+    bool Open(const std::string& path, const DensityGrid& grid);
+    // Appends the grid as the next frame, dt seconds after the one before.
+    // The grid must have the layout it was opened with. Not to be called
+    // from a ThreadPool worker
+    void Write(const DensityGrid& grid, GLfloat dt);
+    // Waits for the last frame and appends the frame index
+    void Close();
+
+    uint64_t GetFrameCount() const { return m_nFrames; }
+    uint64_t GetBytesWritten() const { return m_nBytes; }
+
+private:
+    void WriterLoop();
+    // Blocks until the writer thread wrote m_pending
+    void WaitForWrite();
+
+    std::ofstream m_stream;
+    std::string m_path;
+    // filled by Write, then swapped with m_pending for the writer thread
+    std::vector<char> m_frame;
+    std::vector<char> m_pending;
+    // per active brick, cells with density and the largest density
+    std::vector<uint32_t> m_counts;
+    std::vector<GLfloat> m_maxima;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    // m_pending waits for the writer thread
+    bool m_hasPending;
+    bool m_stop;
+    std::vector<uint64_t> m_offsets;
+    uint64_t m_nFrames;
+    uint64_t m_nBytes;
+    GLfloat m_time;
+};
+
+// Maps a density file read-only. Files still being written, or cut off,
+// are walked frame by frame up to their last complete frame
+class DensityFile {
+public:
+    DensityFile();
+    ~DensityFile();
+
+    DensityFile(const DensityFile&) = delete;
+    DensityFile& operator=(const DensityFile&) = delete;
+
+    // Prints an error and returns false if it is no density file, or one
+    // whose header, index or complete frames don't hold up. Every frame of
+    // an open file lies within the mapping and indexes bricks of its grid
+    bool Open(const std::string& path);
+
+    const DensityFileHeader& GetHeader() const { return *m_header; }
+    size_t GetFrameCount() const { return m_frames.size(); }
+    DensityFrame GetFrame(size_t i) const;
+
+private:
+    void Close();
+    // Prints an error, closes and returns false
+    bool Reject(const std::string& path);
+
+    const char* m_memory;
+    size_t m_size;
+    const DensityFileHeader* m_header;
+    std::vector<uint64_t> m_frames;
+};
@@ -10,138 +10,603 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cstddef>
+#include <limits>
 
-#define N_LOW_P_POINTS 500
+#include "thread_pool.h"
 
-#define Y_OFFSET 0.4f
+#define HEAT_RATE 12.0f
 
-#define VELOCITY_LOW 0.5f
-#define VELOCITY_HIGH 1.5f
+// world units added around the particle bounds, covers the sprite size
+#define CULL_MARGIN 0.5f
 
-#define LIFE_MEAN 3.0f
-#define LIFE_DEVATION 1.0f
+// noise tiles per second the turbulence rises with
+#define TURBULENCE_SCROLL 0.15f
 
-#define SCALE_MEAN 0.05f
-#define SCALE_DEVIATION 0.025f
+// greys from 0.5 to 1.49, brighter than white on purpose
+#define PALETTE_SIZE 100
+
+// Shared by all emitters, built on first use
+static const std::vector<glm::vec3>& Palette()
+{
+    static const std::vector<glm::vec3> palette = [] {
+        std::vector<glm::vec3> colors;
+        for (GLuint i = 0; i < PALETTE_SIZE; ++i) {
+            colors.push_back(glm::vec3(0.5f + i / static_cast<GLfloat>(PALETTE_SIZE)));
+        }
+        return colors;
+    }();
+    return palette;
+}
+
+// Calls fn(first, count) for the one or two contiguous pieces of the ring
+// window of count slots starting at begin
+template <typename F>
+static void ForEachRange(size_t begin, size_t count, size_t capacity, F&& fn)
+{
+    const size_t nFirst = std::min(count, capacity - begin);
+    if (nFirst > 0) {
+        fn(begin, nFirst);
+    }
+    if (count > nFirst) {
+        fn(0, count - nFirst);
+    }
+}
 
 Emitter::Emitter(const Shader& shader,
-                 const Texture2D& texture,
+                 const Texture2DArray& texture,
                  const glm::vec3& position,
                  const glm::vec3& direction,
                  GLfloat radius,
                  GLfloat energy,
                  GLfloat velocity,
-                 GLuint amount)
+                 GLuint amount,
+                 EmitterMode mode,
+                 EmitterEffect effect,
+                 EmitterStorage storage)
     : m_shader(shader),
       m_texture(texture),
-      m_amount(amount),
+      m_modelLocation(-1),
+      m_storage(std::move(storage)),
+      // every ring index is taken modulo the amount
+      m_amount(std::max(amount, 1u)),
+      m_mode(mode),
+      m_effect(effect),
+      m_kernel(nullptr),
+      m_timeLocation(-1),
       m_position(position),
       m_direction(glm::normalize(direction)),
       m_radius(radius),
       m_energy(energy),
       // emit in direction inverse to movement
-      m_velocity(-velocity)
+      m_velocity(-velocity),
+      m_surfaceTransform(1.0f),
+      m_noise(nullptr),
+      m_interactTail(0),
+      m_time(0.0f),
+      m_head(0),
+      m_count(0),
+      m_nSpawned(0),
+      m_culled(false),
+      m_nMapped(0),
+      m_uploadBegin(0),
+      m_nUploads(0),
+      m_captureEvents(false),
+      m_nGroups(1),
+      m_nextGroups(1),
+      m_group(0),
+      m_groupLag{},
+      m_groupTime{},
+      m_seed(0),
+      m_frame(0)
 {
     Init();
 }
 
+Emitter::~Emitter()
+{
+    m_storage.Release();
+}
+
+void EmitterStorage::Release()
+{
+    if (mode != EmitterMode::headless && VAO != 0) {
+        // unused buffers are 0, which GL silently ignores
+        const GLuint buffers[] = {meshVBO, birthVBO, offsetVBO, colorVBO, scaleVBO, layerVBO};
+        glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers);
+        glDeleteVertexArrays(1, &VAO);
+    }
+    *this = EmitterStorage();
+}
+
+EmitterStorage Emitter::ReleaseStorage()
+{
+    m_count = 0;
+    m_nSpawned = 0;
+    EmitterStorage storage = std::move(m_storage);
+    m_storage = EmitterStorage();
+    return storage;
+}
+
 bool Emitter::IsAlive() const
 {
     return m_energy > 0.0f;
 }
 
-void Emitter::Update(GLfloat dt, GLuint nNewParticles, const glm::vec3& offset)
+void Emitter::Extinguish()
+{
+    m_energy = 0.0f;
+}
+
+size_t Emitter::GetParticleCount() const
+{
+    return m_count;
+}
+
+const glm::vec3& Emitter::GetPosition() const
+{
+    return m_position;
+}
+
+void Emitter::Update(GLfloat dt, GLuint nNewParticles, const FluidGrid& fluid,
+                     const glm::vec3& offset)
 {
     m_energy -= dt;
+    // particles spawned by this Update start at its beginning
+    const GLfloat start = m_time;
+    m_time += dt;
+
+    // Pick up a rebuilt volume, the pointer keeps it alive for this step
+    if (m_noise) {
+        m_turbulence.field = m_noise->GetField();
+        m_turbulence.scroll = glm::vec3(0.0f, -TURBULENCE_SCROLL * m_time, 0.0f);
+    }
+
+    m_events.clear();
 
     if (IsAlive()) {
         // Add new particles
-        for (GLuint i = 0; i < nNewParticles; ++i)
-        {
-            const int64_t res = FirstUnusedParticle();
-
-            size_t unusedParticle = 0;
-            if (res < 0) {
-                std::uniform_int_distribution<> distribution(0, m_amount);
-                unusedParticle = distribution(m_rndGenerator);
-            } else {
-                unusedParticle = static_cast<size_t>(res);
+        Emit(nNewParticles, offset, nullptr, 1, start);
+    }
+
+    ++m_frame;
+
+    // The GPU animates stateless particles, only retire expired ones
+    if (m_mode == EmitterMode::stateless) {
+        while (m_count > 0) {
+            const BirthAttributes& birth = m_storage.births[Tail()];
+            if (m_time - birth.spawnTime < birth.life) {
+                break;
             }
+            --m_count;
+        }
+        return;
+    }
 
-            m_particles[unusedParticle] = GenerateParticle(offset);
+    // Update the live window only
+    const ParticleContext context = {fluid, m_position, m_direction, m_turbulence, m_collider,
+                                     m_captureEvents ? &m_events : nullptr};
+    for (GLuint group = 0; group < m_nGroups; ++group) {
+        m_groupLag[group] += dt;
+    }
+    if (m_nGroups == 1 && m_nextGroups == 1) {
+        UpdateGroup(0, context);
+    } else if (m_nextGroups != m_nGroups) {
+        // Catch every group up before the slots change groups
+        for (GLuint group = 0; group < m_nGroups; ++group) {
+            UpdateGroup(group, context);
         }
+        m_nGroups = m_nextGroups;
+        m_group = 0;
+    } else {
+        // One group per Update with all the time it waited
+        UpdateGroup(m_group, context);
+        m_group = (m_group + 1) % m_nGroups;
     }
 
-    m_deadIndexes.clear();
+    if (m_neighbors) {
+        Interact(dt);
+    }
 
-    // Update low pressure points
-    // for (GLuint i = 0; i < N_LOW_P_POINTS; ++i) {
-    //     m_lowPressure[i] = GetLPPoint();
-    // }
-    std::sort(m_lowPressure.begin(), m_lowPressure.end(),
-              [](const auto& a, const auto& b) {
-                  return (glm::length(a) < glm::length(b)) && (a.y < b.y);
-              });
+    // Lifetimes are close to uniform, so the oldest particles expire first.
+    // Ones dying out of order stay in the window as invisible until then
+    while (m_count > 0 && !m_storage.particles[Tail()].IsAlive()) {
+        --m_count;
+    }
+}
 
-    // TODO:
-    // Update all particles
-    for (size_t i = 0; i < m_amount; ++i)
+void Emitter::Emit(size_t n, const glm::vec3& offset, const ParticleEvent* events, size_t perEvent,
+                   GLfloat spawnTime)
+{
+    const SpawnContext spawn = {m_seed, m_frame, m_head, m_amount, m_position, offset,
+                                m_direction * m_velocity, m_radius, m_surface.get(),
+                                m_surfaceTransform, static_cast<GLuint>(Palette().size()),
+                                m_texture.Layers, events, perEvent};
+    m_storage.spawned.clear();
+    m_kernel->Spawn(n, spawn, m_storage.spawned);
+    for (const Particle& particle : m_storage.spawned)
     {
-        Particle& p = m_particles[i];
-        if (!p.Update(dt, m_lowPressure)) {
-            m_deadIndexes.push_back(i);
+        const size_t slot = NextSlot();
+        if (m_mode == EmitterMode::stateless) {
+            m_storage.births[slot] = {particle.GetPosition(), m_time,
+                              particle.GetVelocity(), particle.GetLife(),
+                              glm::vec4(Palette()[particle.GetColor()], 1.0f),
+                              particle.GetScale(), particle.GetLayer()};
+        } else {
+            m_storage.particles[slot] = particle;
+            m_spawnTimes[slot] = spawnTime;
         }
     }
 }
 
-glm::vec3 Emitter::GetLPPoint()
+void Emitter::SpawnAt(const ParticleEvent* events, size_t nEvents, GLuint perEvent)
 {
-    std::normal_distribution<> xz_distribution(0.0f, m_radius / 1.5);
-    std::normal_distribution<> y_distribution(0.0f, 20.0f / 4);
-    // std::normal_distribution<> xz_distribution(0.0f, m_radius / 4);
-    // std::uniform_int_distribution<> y_distribution(m_position.y + 1,
-    //                                                m_position.y + 20);
-    return glm::vec3(xz_distribution(m_rndGenerator),
-                     y_distribution(m_rndGenerator),
-                     xz_distribution(m_rndGenerator));
+    if (IsAlive() && nEvents > 0 && perEvent > 0) {
+        Emit(nEvents * perEvent, glm::vec3(0.0f), events, perEvent, m_time);
+    }
 }
 
-// Render all particles
-void Emitter::Draw()
+void Emitter::UpdateGroup(GLuint group, const ParticleContext& context)
 {
-    // Use additive blending to give it a 'glow' effect
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    m_shader.Use();
+    // Oldest first, so the particles spawned since the group's last step
+    // come last, in runs of one spawn time each
+    ForEachRange(Tail(), m_count, m_amount, [&](size_t first, size_t count) {
+        size_t from = std::max(first, GroupBegin(group));
+        const size_t to = std::min(first + count, GroupBegin(group + 1));
+        while (from < to) {
+            const GLfloat dt = Lag(from);
+            size_t next = from + 1;
+            while (next < to && Lag(next) == dt) {
+                ++next;
+            }
+            m_kernel->Update(&m_storage.particles[from], next - from, dt, context);
+            from = next;
+        }
+    });
+    m_groupLag[group] = 0.0f;
+    m_groupTime[group] = m_time;
+}
+
+void Emitter::AddHeat(FluidGrid& fluid, GLfloat dt, const glm::vec3& offset) const
+{
+    // heat drives the flow for the next fluid step
+    if (IsAlive()) {
+        fluid.AddHeat(m_position + offset, m_radius, HEAT_RATE * dt);
+    }
+}
+
+void Emitter::SetEmissionSurface(std::shared_ptr<const SurfaceSampler> surface,
+                                 const glm::mat4& transform)
+{
+    // a mesh that failed to load, or has no area, is no surface
+    m_surface = surface && !surface->Empty() ? std::move(surface) : nullptr;
+    m_surfaceTransform = transform;
+    SelectKernel();
+}
+
+void Emitter::SetSurfaceTransform(const glm::mat4& transform)
+{
+    m_surfaceTransform = transform;
+}
+
+void Emitter::SetTurbulence(const CurlNoise* noise, GLfloat amplitude, GLfloat frequency)
+{
+    m_noise = noise;
+    m_turbulence.field.reset();
+    m_turbulence.amplitude = amplitude;
+    m_turbulence.frequency = frequency;
+    SelectKernel();
+}
+
+void Emitter::SetCollider(const Collider& collider)
+{
+    m_collider = collider;
+    SelectKernel();
+}
+
+void Emitter::SelectKernel()
+{
+    m_kernel = EmitterKernel::Create(m_effect, m_surface != nullptr, m_noise != nullptr,
+                                     m_collider.field != nullptr);
+}
+
+void Emitter::SetSeed(uint64_t seed)
+{
+    m_seed = seed;
+}
+
+void Emitter::SetEventCapture(bool capture)
+{
+    m_captureEvents = capture;
+    m_events.clear();
+}
+
+void Emitter::SetUpdateGroups(GLuint nGroups)
+{
+    m_nextGroups = std::clamp(nGroups, 1u, MAX_UPDATE_GROUPS);
+}
+
+void Emitter::SetInteraction(const ParticleInteraction& interaction)
+{
+    m_interaction = interaction;
+    if (interaction.radius > 0.0f)
+        m_neighbors.reset(new SpatialHash(interaction.radius));
+    else
+        m_neighbors.reset();
+}
+
+size_t Emitter::QueryNeighbors(const glm::vec3& position, GLfloat radius,
+                               std::vector<size_t>& slots) const
+{
+    if (!m_neighbors) {
+        return 0;
+    }
+    const size_t first = slots.size();
+    m_neighbors->ForEachNeighbor(position, radius, [&](GLuint i, const glm::vec3&) {
+        if (m_liveAlive[i]) {
+            slots.push_back((m_interactTail + i) % m_amount);
+        }
+    });
+    return slots.size() - first;
+}
+
+void Emitter::Interact(GLfloat dt)
+{
+    const size_t tail = Tail();
+    const size_t count = m_count;
+    m_interactTail = tail;
+    m_livePositions.resize(count);
+    m_liveAlive.resize(count);
+    m_density.resize(count);
+    ThreadPool& pool = ThreadPool::Instance();
+
+    // 1. World positions of the live window, in window order
+    pool.ParallelFor(0, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            Particle& particle = m_storage.particles[(tail + i) % m_amount];
+            m_livePositions[i] = m_position + particle.GetPosition();
+            m_liveAlive[i] = particle.IsAlive();
+        }
+    });
+    m_neighbors->Build(m_livePositions.data(), count);
+
+    const GLfloat h = m_interaction.radius;
+    const GLfloat invH2 = 1.0f / (h * h);
+
+    // 2. Density, poly6 shaped kernel normalized to 1 at the center
+    pool.ParallelFor(0, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            GLfloat density = 0.0f;
+            if (m_liveAlive[i]) {
+                m_neighbors->ForEachNeighbor(m_livePositions[i], h, [&](GLuint j, const glm::vec3& offset) {
+                    if (m_liveAlive[j]) {
+                        const GLfloat w = 1.0f - glm::dot(offset, offset) * invH2;
+                        density += w * w * w;
+                    }
+                });
+            }
+            m_density[i] = density;
+        }
+    });
+
+    // 3. Symmetric pressure plus cohesion, each job only writes its own
+    // particles so no synchronization is needed
+    const GLfloat restDensity = m_interaction.restDensity;
+    const GLfloat stiffness = m_interaction.stiffness;
+    const GLfloat cohesion = m_interaction.cohesion;
+    pool.ParallelFor(0, count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!m_liveAlive[i]) {
+                continue;
+            }
+            const GLfloat pressure = std::max(m_density[i] - restDensity, 0.0f);
+            glm::vec3 acceleration(0.0f);
+            m_neighbors->ForEachNeighbor(m_livePositions[i], h, [&](GLuint j, const glm::vec3& offset) {
+                const GLfloat distance = glm::length(offset);
+                if (j == i || !m_liveAlive[j] || distance <= 0.0f) {
+                    return;
+                }
+                const GLfloat q = 1.0f - distance / h;
+                const GLfloat shared = 0.5f * (pressure + std::max(m_density[j] - restDensity, 0.0f));
+                // pushes apart up close, pulls together towards the radius
+                const GLfloat magnitude = stiffness * shared * q * q - cohesion * q * (1.0f - q);
+                acceleration += offset * (magnitude / distance);
+            });
+            m_storage.particles[(tail + i) % m_amount].AddVelocity(acceleration * dt);
+        }
+    });
+}
+
+bool Emitter::Cull(const Frustum& frustum)
+{
+    // The GPU moves stateless particles, their bounds are unknown here
+    if (m_mode != EmitterMode::simulated) {
+        m_culled = false;
+        return true;
+    }
+    glm::vec3 min(std::numeric_limits<GLfloat>::max());
+    glm::vec3 max(-std::numeric_limits<GLfloat>::max());
+    ForEachRange(Tail(), m_count, m_amount, [&](size_t first, size_t count) {
+        for (size_t i = first; i < first + count; ++i) {
+            const glm::vec3& position = m_storage.particles[i].GetPosition();
+            min = glm::min(min, position);
+            max = glm::max(max, position);
+        }
+    });
+    m_culled = m_count == 0 || !frustum.Intersects(m_position + min - CULL_MARGIN,
+                                                   m_position + max + CULL_MARGIN);
+    return !m_culled;
+}
+
+void Emitter::Map()
+{
+    if (m_mode == EmitterMode::headless || m_culled) {
+        return;
+    }
+    // Slots written since the last upload, a full lap covers the whole
+    // ring. Culled frames keep counting
+    m_nUploads = std::min(m_nSpawned, m_amount);
+    m_uploadBegin = (m_head + m_amount - m_nUploads) % m_amount;
+    m_nSpawned = 0;
+    if (m_mode == EmitterMode::stateless) {
+        return;
+    }
 
-    glm::vec3* ptrOffset = static_cast<glm::vec3*>(glMapNamedBuffer(m_offsetVBO, GL_WRITE_ONLY));
-    glm::vec4* ptrColors = static_cast<glm::vec4*>(glMapNamedBuffer(m_colorVBO, GL_WRITE_ONLY));
-    GLfloat* ptrScale = static_cast<GLfloat*>(glMapNamedBuffer(m_scaleVBO, GL_WRITE_ONLY));
+    // Every live particle moved, so the live window is the dirty range
+    const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+    ForEachRange(Tail(), m_count, m_amount, [&](size_t first, size_t count) {
+        MappedRange& range = m_mapped[m_nMapped++];
+        range = {first, count, nullptr, nullptr, nullptr, nullptr};
+        range.offsets = static_cast<glm::vec3*>(glMapNamedBufferRange(
+            m_storage.offsetVBO, sizeof(glm::vec3) * first, sizeof(glm::vec3) * count, access));
+        range.colors = static_cast<glm::vec4*>(glMapNamedBufferRange(
+            m_storage.colorVBO, sizeof(glm::vec4) * first, sizeof(glm::vec4) * count, access));
+        range.scales = static_cast<GLfloat*>(glMapNamedBufferRange(
+            m_storage.scaleVBO, sizeof(GLfloat) * first, sizeof(GLfloat) * count, access));
+    });
+    // The sprite layer never changes after spawn. Layer ranges follow the
+    // live ones in m_mapped
+    ForEachRange(m_uploadBegin, m_nUploads, m_amount, [&](size_t first, size_t count) {
+        MappedRange& range = m_mapped[m_nMapped++];
+        range = {first, count, nullptr, nullptr, nullptr, nullptr};
+        range.layers = static_cast<GLuint*>(glMapNamedBufferRange(
+            m_storage.layerVBO, sizeof(GLuint) * first, sizeof(GLuint) * count, access));
+    });
+}
 
-    for (size_t i = 0; i < m_amount; ++i) {
-        if (m_particles[i].IsAlive()) {
-            ptrOffset[i] = m_particles[i].GetPosition();
-            ptrColors[i] = m_particles[i].GetColor();
-            ptrScale[i] = m_particles[i].GetScale();
+void Emitter::Fill()
+{
+    for (size_t i = 0; i < m_nMapped; ++i) {
+        const MappedRange& range = m_mapped[i];
+        if (range.layers) {
+            for (size_t j = 0; j < range.count; ++j) {
+                range.layers[j] = m_storage.particles[range.first + j].GetLayer();
+            }
+        } else {
+            m_kernel->Fill(&m_storage.particles[range.first], range.count, Palette(),
+                           range.offsets, range.colors, range.scales);
+            if (m_nGroups > 1) {
+                // groups waiting for their step are drawn where they
+                // would be by now
+                for (size_t j = 0; j < range.count; ++j) {
+                    const size_t slot = range.first + j;
+                    const Particle& particle = m_storage.particles[slot];
+                    range.offsets[j] = particle.GetPosition() + particle.GetVelocity() * Lag(slot);
+                }
+            }
         }
     }
+}
 
-    glUnmapNamedBuffer(m_offsetVBO);
-    glUnmapNamedBuffer(m_colorVBO);
-    glUnmapNamedBuffer(m_scaleVBO);
+void Emitter::Submit()
+{
+    if (m_mode == EmitterMode::headless || m_culled) {
+        return;
+    }
+    // Use additive blending to give it a 'glow' effect
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    m_shader.Use();
+    // the shader is shared with the other emitters
+    m_shader.SetMatrix4(m_modelLocation, glm::translate(glm::mat4(1.0f), m_position));
+
+    if (m_mode == EmitterMode::stateless) {
+        m_shader.SetFloat(m_timeLocation, m_time);
+        ForEachRange(m_uploadBegin, m_nUploads, m_amount, [this](size_t first, size_t count) {
+            glNamedBufferSubData(m_storage.birthVBO, sizeof(BirthAttributes) * first,
+                                 sizeof(BirthAttributes) * count, &m_storage.births[first]);
+        });
+    }
+    for (size_t i = 0; i < m_nMapped; ++i) {
+        if (m_mapped[i].layers) {
+            glUnmapNamedBuffer(m_storage.layerVBO);
+        } else {
+            glUnmapNamedBuffer(m_storage.offsetVBO);
+            glUnmapNamedBuffer(m_storage.colorVBO);
+            glUnmapNamedBuffer(m_storage.scaleVBO);
+        }
+    }
+    m_nMapped = 0;
+    m_nUploads = 0;
 
-    glBindVertexArray(m_VAO);
+    glBindVertexArray(m_storage.VAO);
 
     m_texture.Bind();
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, m_amount);
+    // Instances outside of the live window are skipped entirely
+    ForEachRange(Tail(), m_count, m_amount, [](size_t first, size_t count) {
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, count, first);
+    });
     glBindVertexArray(0);
     // Don't forget to reset to default blending mode
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+// Render all particles
+void Emitter::Draw()
+{
+    m_culled = false;
+    Map();
+    Fill();
+    Submit();
+}
+
+size_t Emitter::Export(glm::vec3* offsets, glm::vec4* colors, GLfloat* scales, GLuint* layers,
+                       size_t capacity, GLfloat* ages) const
+{
+    if (m_mode == EmitterMode::stateless) {
+        return 0;
+    }
+    size_t n = 0;
+    ForEachRange(Tail(), std::min(m_count, capacity), m_amount, [&](size_t first, size_t count) {
+        m_kernel->Fill(&m_storage.particles[first], count, Palette(), offsets + n, colors + n,
+                       scales + n);
+        for (size_t i = 0; i < count; ++i) {
+            layers[n + i] = m_storage.particles[first + i].GetLayer();
+        }
+        if (ages) {
+            for (size_t i = 0; i < count; ++i) {
+                ages[n + i] = m_storage.particles[first + i].GetAge();
+            }
+        }
+        n += count;
+    });
+    return n;
+}
+
 void Emitter::Init()
+{
+    SelectKernel();
+
+    // Storage of another mode or too small for this emitter is of no use.
+    // Storage without buffers yet gets them at its capacity
+    if (m_storage.mode != m_mode || m_storage.capacity < m_amount) {
+        m_storage.Release();
+        m_storage.mode = m_mode;
+        m_storage.capacity = m_amount;
+    }
+    if (m_mode != EmitterMode::headless && m_storage.VAO == 0) {
+        InitBuffers();
+    }
+
+    // allocated for the full capacity once, reused storage keeps it
+    if (m_mode == EmitterMode::stateless) {
+        m_storage.births.reserve(m_storage.capacity);
+        // zero life marks every slot as expired
+        m_storage.births.assign(m_amount, BirthAttributes());
+    } else {
+        m_storage.particles.reserve(m_storage.capacity);
+        m_storage.particles.assign(m_amount, Particle());
+        m_spawnTimes.assign(m_amount, 0.0f);
+    }
+
+    if (m_mode != EmitterMode::headless) {
+        m_modelLocation = m_shader.GetUniformLocation("model");
+        m_timeLocation = m_shader.GetUniformLocation("emitterTime");
+    }
+}
+
+GLuint Emitter::InitMesh(GLuint VAO)
 {
     // Set up mesh and attribute properties
-    GLuint VBO;
     GLfloat particle_cube[] = {
         // positions          // texture coords
        -0.5f, -0.5f, -0.5f,  0.0f, 0.0f,
@@ -187,9 +652,9 @@ void Emitter::Init()
        -0.5f,  0.5f, -0.5f,  0.0f, 1.0f
     };
 
-    glGenVertexArrays(1, &m_VAO);
+    GLuint VBO;
     glGenBuffers(1, &VBO);
-    glBindVertexArray(m_VAO);
+    glBindVertexArray(VAO);
     // Fill mesh buffer
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(particle_cube), particle_cube, GL_STATIC_DRAW);
@@ -200,98 +665,117 @@ void Emitter::Init()
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
 
     glBindVertexArray(0);
+    return VBO;
+}
 
-    // memory consuming but fast and reliable
-    m_particles.reserve(m_amount);
-    m_deadIndexes.reserve(m_amount);
-
-    // Create this->amount default particle instances
-    for (GLuint i = 0; i < m_amount; ++i) {
-        m_particles.push_back(Particle());
-    }
+void Emitter::InitBuffers()
+{
+    glGenVertexArrays(1, &m_storage.VAO);
+    m_storage.meshVBO = InitMesh(m_storage.VAO);
 
-    m_lowPressure.reserve(N_LOW_P_POINTS);
-    for (GLuint i = 0; i < N_LOW_P_POINTS; ++i) {
-        m_lowPressure.push_back(GetLPPoint());
+    if (m_mode == EmitterMode::stateless) {
+        InitStateless();
+        return;
     }
 
-    glm::mat4 model(1.0f);
-    model = glm::translate(model, m_position);
-    m_shader.SetMatrix4("model", model);
-
     // setUp VBOs
-    glGenBuffers(1, &m_offsetVBO);
-    glGenBuffers(1, &m_colorVBO);
-    glGenBuffers(1, &m_scaleVBO);
+    glGenBuffers(1, &m_storage.offsetVBO);
+    glGenBuffers(1, &m_storage.colorVBO);
+    glGenBuffers(1, &m_storage.scaleVBO);
+    glGenBuffers(1, &m_storage.layerVBO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_offsetVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * m_amount, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.offsetVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * m_storage.capacity, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_amount, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.colorVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_storage.capacity, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_scaleVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * m_amount, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.scaleVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * m_storage.capacity, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.layerVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(GLuint) * m_storage.capacity, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_DRAW);
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // setUp VAO
-    glBindVertexArray(m_VAO);
+    glBindVertexArray(m_storage.VAO);
 
     glEnableVertexAttribArray(2);
-    glBindBuffer(GL_ARRAY_BUFFER, m_offsetVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.offsetVBO);
     glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glVertexAttribDivisor(2, 1);
 
     glEnableVertexAttribArray(3);
-    glBindBuffer(GL_ARRAY_BUFFER, m_colorVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.colorVBO);
     glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glVertexAttribDivisor(3, 1);
 
     glEnableVertexAttribArray(4);
-    glBindBuffer(GL_ARRAY_BUFFER, m_scaleVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.scaleVBO);
     glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, 1 * sizeof(float), (void*)0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glVertexAttribDivisor(4, 1);
-}
 
-int64_t Emitter::FirstUnusedParticle()
-{
-    if (!m_deadIndexes.empty()) {
-        int64_t res = m_deadIndexes.back();
-        m_deadIndexes.pop_back();
-        return res;
-    } else {
-        return -1;
-    }
+    glEnableVertexAttribArray(5);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.layerVBO);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, 1 * sizeof(GLuint), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glVertexAttribDivisor(5, 1);
 }
 
-// can't be const, ca'z modifies m_rndGenerator
-Particle Emitter::GenerateParticle(const glm::vec3& offset)
+void Emitter::InitStateless()
 {
-    // we set stddev as R / 4
-    std::normal_distribution<> posDistribution(0.0f, m_radius / 4);
-    std::uniform_real_distribution yDistribution(0.0f, Y_OFFSET);
+    // Left undefined, only slots of the live window are ever drawn and
+    // those were uploaded at spawn
+    glCreateBuffers(1, &m_storage.birthVBO);
+    glNamedBufferStorage(m_storage.birthVBO, sizeof(BirthAttributes) * m_storage.capacity, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+
+    glBindVertexArray(m_storage.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_storage.birthVBO);
+    const GLsizei stride = sizeof(BirthAttributes);
 
-    const glm::vec3 random = {posDistribution(m_rndGenerator), yDistribution(m_rndGenerator),
-                              posDistribution(m_rndGenerator)};
+    // position + spawn time
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BirthAttributes, position));
+    glVertexAttribDivisor(2, 1);
+    // velocity + life
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BirthAttributes, velocity));
+    glVertexAttribDivisor(3, 1);
 
-    std::uniform_real_distribution velocityDistribution(VELOCITY_LOW, VELOCITY_HIGH);
-    const GLfloat velocityFactor = velocityDistribution(m_rndGenerator);
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BirthAttributes, color));
+    glVertexAttribDivisor(4, 1);
 
-    const glm::vec3 position = random + offset;
-    const glm::vec3 velocity = m_direction * m_velocity * velocityFactor;
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(BirthAttributes, scale));
+    glVertexAttribDivisor(5, 1);
 
-    const GLfloat fColor = 0.5 + ((rand() % 100) / 100.0f);
-    const glm::vec4 color(fColor, fColor, fColor, 1.0f);
+    glEnableVertexAttribArray(6);
+    glVertexAttribIPointer(6, 1, GL_UNSIGNED_INT, stride, (void*)offsetof(BirthAttributes, layer));
+    glVertexAttribDivisor(6, 1);
 
-    std::normal_distribution<> lifeDistriburion(LIFE_MEAN, LIFE_DEVATION);
-    const GLfloat fLife = lifeDistriburion(m_rndGenerator);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
 
-    std::normal_distribution<> scaleDistriburion(SCALE_MEAN, SCALE_DEVIATION);
-    const GLfloat fScale = scaleDistriburion(m_rndGenerator);
+size_t Emitter::NextSlot()
+{
+    const size_t slot = m_head;
+    m_head = (m_head + 1) % m_amount;
+    ++m_nSpawned;
+    // A full ring recycles its oldest particle
+    if (m_count < m_amount) {
+        ++m_count;
+    }
+    return slot;
+}
 
-    return Particle(position, velocity, color, fLife, fScale);
+size_t Emitter::Tail() const
+{
+    return (m_head + m_amount - m_count) % m_amount;
 }
@@ -10,57 +10,246 @@
 
 #include <GL/glew.h>
 
+#include <cstdint>
 #include <glm/glm.hpp>
-#include <random>
 #include <vector>
 #include <memory>
 
+#include "camera.h"
+#include "curl_noise.h"
+#include "emitter_kernel.h"
+#include "fluid_grid.h"
+#include "mesh.h"
 #include "particle.h"
 #include "shader.h"
+#include "spatial_hash.h"
 #include "texture.h"
 
+// How particle attributes reach the GPU
+enum class EmitterMode {
+    // simulated on the CPU, all live particles are re-uploaded every frame
+    simulated,
+    // birth attributes are uploaded once at spawn and the vertex shader
+    // evaluates fade, shrink and ballistic motion from the emitter time.
+    // Fluid and turbulence do not apply in this mode
+    stateless,
+    // simulated without any GL resources, Draw does nothing. For
+    // benchmarks running without a context
+    headless
+};
+
+// Per-particle data written once at spawn in EmitterMode::stateless,
+// matches the instance attributes of particle_stateless.vs
+struct BirthAttributes {
+    glm::vec3 position;
+    GLfloat spawnTime;
+    glm::vec3 velocity;
+    GLfloat life;
+    glm::vec4 color;
+    GLfloat scale;
+    GLuint layer;
+};
+
+// GL objects and particle storage of an emitter, everything that is
+// expensive to create. EmitterManager hands it from retired emitters to
+// new ones of the same mode instead of freeing it
+struct EmitterStorage {
+    EmitterMode mode = EmitterMode::headless;
+    // particles the buffers hold. The first emitter creates the buffers,
+    // so storage with only mode and capacity set reserves a size
+    size_t capacity = 0;
+
+    // EmitterMode::simulated and headless
+    std::vector<Particle> particles;
+    // EmitterMode::stateless
+    std::vector<BirthAttributes> births;
+    // scratch for the particles spawned in one Update
+    std::vector<Particle> spawned;
+
+    GLuint VAO = 0;
+    GLuint meshVBO = 0;
+    GLuint birthVBO = 0;
+    GLuint offsetVBO = 0;
+    GLuint colorVBO = 0;
+    GLuint scaleVBO = 0;
+    GLuint layerVBO = 0;
+
+    // Frees the GL objects and the memory, leaving empty storage
+    void Release();
+};
+
+// Particle-particle forces of EmitterMode::simulated. Densities are sums
+// of a smooth kernel over the neighbours within radius, a lone particle
+// has density 1
+struct ParticleInteraction {
+    // neighbourhood size in world units, 0 disables interactions
+    GLfloat radius = 0.0f;
+    // density above which particles push each other apart
+    GLfloat restDensity = 4.0f;
+    // repulsion in units per second squared per unit of excess density
+    GLfloat stiffness = 0.5f;
+    // pull towards neighbours in units per second squared
+    GLfloat cohesion = 0.0f;
+};
+
 // Emitter acts as a container for rendering a large number of
 // particles by repeatedly spawning and updating particles and killing
 // them after a given amount of time.
 class Emitter {
 public:
-    // Constructor
+    // Most groups SetUpdateGroups splits the particles into
+    static const GLuint MAX_UPDATE_GROUPS = 8;
+
+    // Constructor, storage with enough capacity for amount particles of
+    // this mode is reused, anything else is released and recreated. An
+    // amount of 0 holds a single particle
     Emitter(const Shader& shader,
-            const Texture2D& texture,
+            const Texture2DArray& texture,
             const glm::vec3& position,
             const glm::vec3& direction,
             GLfloat radius,
             GLfloat energy,
             GLfloat velocity,
-            GLuint amount);
+            GLuint amount,
+            EmitterMode mode = EmitterMode::simulated,
+            EmitterEffect effect = EmitterEffect::fire,
+            EmitterStorage storage = EmitterStorage());
+    // Releases the GL buffers unless handed on through ReleaseStorage
+    ~Emitter();
+
+    Emitter(const Emitter&) = delete;
+    Emitter& operator=(const Emitter&) = delete;
 
-    // TODO: pass Object that is on fire here
-    // Update all particles
-    void Update(GLfloat dt, GLuint nNewParticles,
+    // Update all particles, advecting them through the fluid. Emitters
+    // only read the fluid here, so they may update in parallel
+    void Update(GLfloat dt, GLuint nNewParticles, const FluidGrid& fluid,
                 const glm::vec3& offset = glm::vec3(0.0f));
-    // Render all particles
+    // Feeds the fluid with the heat of the fire while the emitter is
+    // alive, after Update with the same dt and offset
+    void AddHeat(FluidGrid& fluid, GLfloat dt, const glm::vec3& offset = glm::vec3(0.0f)) const;
+    // Spawns particles on the surface of a mesh instead of the blob around
+    // the emitter position. transform maps the mesh into world space,
+    // nullptr or an empty sampler restores the blob
+    void SetEmissionSurface(std::shared_ptr<const SurfaceSampler> surface,
+                            const glm::mat4& transform = glm::mat4(1.0f));
+    // Moves the burning object
+    void SetSurfaceTransform(const glm::mat4& transform);
+    // Adds curl noise flicker, amplitude in units per second, frequency in
+    // noise tiles per unit. Pass nullptr to disable
+    void SetTurbulence(const CurlNoise* noise, GLfloat amplitude, GLfloat frequency);
+    // Makes particles collide with static geometry, a collider without
+    // field disables it. EmitterMode::stateless particles ignore it
+    void SetCollider(const Collider& collider);
+    // Keys the random streams of the particles spawned from now on. Two
+    // emitters with the same seed and history spawn identical particles
+    void SetSeed(uint64_t seed);
+    // Enables density, repulsion and cohesion between particles
+    void SetInteraction(const ParticleInteraction& interaction);
+    // Records the particles dying or killed by the collider in each
+    // Update, for sub-emitters. EmitterMode::stateless records nothing
+    void SetEventCapture(bool capture);
+    // Events of the last Update
+    const std::vector<ParticleEvent>& GetEvents() const { return m_events; }
+    // Spawns perEvent particles around each of the events, as a
+    // sub-emitter. Positions are world space, the emitter's offset and
+    // surface don't apply
+    void SpawnAt(const ParticleEvent* events, size_t nEvents, GLuint perEvent);
+    // Simulation LOD: splits the ring into nGroups slot ranges and steps
+    // one of them per Update, round-robin, with the time it accumulated
+    // since its last step, particles spawned since with the time since
+    // their spawn. Drawing extrapolates the waiting groups along their
+    // velocity the same way. Spawning, aging of the ring and interactions still
+    // run every Update. Takes effect with the next Update, which catches
+    // up all groups first. 1 steps every particle every Update
+    void SetUpdateGroups(GLuint nGroups);
+    GLuint GetUpdateGroups() const { return m_nGroups; }
+    // Appends the ring slots of the live particles within radius of the
+    // world position, as of the last Update. radius must not exceed the
+    // interaction radius, returns 0 without interactions
+    size_t QueryNeighbors(const glm::vec3& position, GLfloat radius,
+                          std::vector<size_t>& slots) const;
+    // Render all particles, same as Map, Fill and Submit in a row
     void Draw();
+    // Draw in stages for spreading it over threads. Cull and Fill run on
+    // any thread, Map and Submit need the GL context. No Update between
+    // Cull and Submit. Cull skips the other stages when the particles are
+    // outside of the frustum, only EmitterMode::simulated is culled
+    bool Cull(const Frustum& frustum);
+    void Map();
+    void Fill();
+    void Submit();
+    // Writes the draw attributes of up to capacity live particles, oldest
+    // first, as Fill would. Offsets are relative to the emitter position,
+    // ages as Particle::GetAge if given. Returns the number written, 0 for
+    // EmitterMode::stateless
+    size_t Export(glm::vec3* offsets, glm::vec4* colors, GLfloat* scales, GLuint* layers,
+                  size_t capacity, GLfloat* ages = nullptr) const;
+    // Creates the particle cube buffer and sets up attributes 0 and 1 of
+    // VAO for it, returns the buffer
+    static GLuint InitMesh(GLuint VAO);
     bool IsAlive() const;
+    // Stops spawning, the live particles burn out on their own
+    void Extinguish();
+    size_t GetParticleCount() const;
+    const glm::vec3& GetPosition() const;
+    // Radius of the spawn blob
+    GLfloat GetRadius() const { return m_radius; }
+    // Gives up the buffers and particles for another emitter, this one
+    // is empty and must not be updated or drawn anymore
+    EmitterStorage ReleaseStorage();
 
 private:
-    // Initializes buffer and vertex attributes
+    // Picks up or creates the storage and resets it for this emitter
     void Init();
-    // Returns the first Particle index that's currently unused e.g. Life <=
-    // 0.0f or 0 if no particle is currently inactive
-    int64_t FirstUnusedParticle();
-    Particle GenerateParticle(const glm::vec3& offset);
-    glm::vec3 GetLPPoint();
+    // Creates the buffers and vertex attributes of m_storage
+    void InitBuffers();
+    // Sets up the birth attribute buffer of EmitterMode::stateless
+    void InitStateless();
+    // Claims the slot at the head of the ring, overwriting the oldest
+    // particle when the ring is full
+    size_t NextSlot();
+    // Slot of the oldest particle in the live window
+    size_t Tail() const;
+    // Specializes the update loop for the current effect, emission shape,
+    // turbulence and collider, called whenever one of them changes
+    void SelectKernel();
+    // Rebuilds the neighbour hash and applies the interaction forces
+    void Interact(GLfloat dt);
+    // Spawns n particles into the ring, events as in SpawnContext. They
+    // are as of spawnTime
+    void Emit(size_t n, const glm::vec3& offset, const ParticleEvent* events, size_t perEvent,
+              GLfloat spawnTime);
+    // Steps the live particles of a group up to m_time
+    void UpdateGroup(GLuint group, const ParticleContext& context);
+    // Update group of a ring slot and the first slot of a group
+    size_t GroupOf(size_t slot) const { return slot * m_nGroups / m_amount; }
+    size_t GroupBegin(size_t group) const { return (group * m_amount + m_nGroups - 1) / m_nGroups; }
+    // Seconds the particle of a slot is behind m_time: its group's lag, or
+    // the time since its spawn if it spawned after the group's last step
+    GLfloat Lag(size_t slot) const
+    {
+        const size_t group = GroupOf(slot);
+        return m_spawnTimes[slot] > m_groupTime[group] ? m_time - m_spawnTimes[slot]
+                                                       : m_groupLag[group];
+    }
 
     // Render state
     Shader m_shader;
-    Texture2D m_texture;
-    GLuint m_VAO;
+    Texture2DArray m_texture;
+    GLint m_modelLocation;
 
     // State
-    std::vector<Particle> m_particles;
-    std::vector<glm::vec3> m_lowPressure;
-    std::vector<size_t> m_deadIndexes;
+    // particles and births are FIFO rings: new particles are appended at
+    // m_head, the m_count slots before it form the live window and
+    // expire from its tail
+    EmitterStorage m_storage;
     const size_t m_amount;
+    const EmitterMode m_mode;
+    const EmitterEffect m_effect;
+    const EmitterKernel* m_kernel;
+
+    // EmitterMode::stateless only
+    GLint m_timeLocation;
 
     const glm::vec3 m_position;
     const glm::vec3 m_direction;
@@ -68,9 +257,65 @@ private:
     GLfloat m_energy;
     const GLfloat m_velocity;
 
-    GLuint m_offsetVBO;
-    GLuint m_colorVBO;
-    GLuint m_scaleVBO;
+    std::shared_ptr<const SurfaceSampler> m_surface;
+    glm::mat4 m_surfaceTransform;
+
+    const CurlNoise* m_noise;
+    Turbulence m_turbulence;
+    Collider m_collider;
+
+    ParticleInteraction m_interaction;
+    std::unique_ptr<SpatialHash> m_neighbors;
+    // per live window index, filled by Interact
+    std::vector<glm::vec3> m_livePositions;
+    std::vector<GLubyte> m_liveAlive;
+    std::vector<GLfloat> m_density;
+    // ring slot of window index 0 when the hash was built, expired
+    // particles are dropped from the window after that
+    size_t m_interactTail;
+    GLfloat m_time;
+
+    size_t m_head;
+    size_t m_count;
+    // slots claimed since the last upload, ending at m_head
+    size_t m_nSpawned;
+
+    // Draw stages
+    // Buffer range mapped for Fill: offsets, colors and scales of live
+    // particles, or layers of new ones
+    struct MappedRange {
+        size_t first;
+        size_t count;
+        glm::vec3* offsets;
+        glm::vec4* colors;
+        GLfloat* scales;
+        GLuint* layers;
+    };
+    bool m_culled;
+    // two pieces of the live window plus two of the spawned slots
+    MappedRange m_mapped[4];
+    size_t m_nMapped;
+    // spawned slots uploaded by this draw
+    size_t m_uploadBegin;
+    size_t m_nUploads;
+
+    // see SetEventCapture
+    bool m_captureEvents;
+    std::vector<ParticleEvent> m_events;
+
+    // Simulation LOD, see SetUpdateGroups
+    GLuint m_nGroups;
+    GLuint m_nextGroups;
+    // group stepped by the next Update
+    GLuint m_group;
+    // seconds each group is behind m_time, and the m_time it was last
+    // stepped at
+    GLfloat m_groupLag[MAX_UPDATE_GROUPS];
+    GLfloat m_groupTime[MAX_UPDATE_GROUPS];
+    // per ring slot, the time its particle spawned at
+    std::vector<GLfloat> m_spawnTimes;
 
-    std::default_random_engine m_rndGenerator;
+    // spawn randomness is a function of these and the ring slot only
+    uint64_t m_seed;
+    uint32_t m_frame;
 };
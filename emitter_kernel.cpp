@@ -0,0 +1,282 @@
+#include "emitter_kernel.h"
+
+#include <algorithm>
+
+#include "philox.h"
+
+namespace {
+
+// ParticleRandom channels, positions stay put when the attributes change
+constexpr uint32_t POSITION_CHANNEL = 0;
+constexpr uint32_t ATTRIBUTE_CHANNEL = 1;
+
+// share of a dying particle's velocity its sub-emitter particles start with
+constexpr GLfloat EVENT_VELOCITY_SHARE = 0.5f;
+
+// Force models: velocity change of one particle over dt {{{
+
+// Boosted along the launch direction and dragged towards the local flow
+struct FluidForce {
+    // per update, not per second
+    static constexpr GLfloat ACCELERATION = 0.02f;
+    static constexpr GLfloat DRAG = 1.5f;
+
+    static glm::vec3 Delta(GLfloat dt, const Particle& particle, const ParticleContext& context)
+    {
+        const glm::vec3 boosted = particle.GetVelocity() + context.direction * ACCELERATION;
+        const glm::vec3 flow = context.fluid.SampleVelocity(context.origin + particle.GetPosition());
+        return boosted - particle.GetVelocity() + (flow - boosted) * std::min(dt * DRAG, 1.0f);
+    }
+};
+
+// Gravity and air drag, never looks at the fluid
+struct BallisticForce {
+    static constexpr GLfloat GRAVITY = 9.81f;
+    static constexpr GLfloat DRAG = 0.8f;
+
+    static glm::vec3 Delta(GLfloat dt, const Particle& particle, const ParticleContext&)
+    {
+        return glm::vec3(0.0f, -GRAVITY * dt, 0.0f) -
+               particle.GetVelocity() * std::min(dt * DRAG, 1.0f);
+    }
+};
+// }}}
+
+// Color models {{{
+
+// Palette color, fading out
+struct PaletteColor {
+    static glm::vec4 Evaluate(const Particle& particle, const std::vector<glm::vec3>& palette)
+    {
+        return glm::vec4(palette[particle.GetColor()], particle.GetAlpha());
+    }
+};
+
+// Cools from yellow-white to dark red, the palette varies the brightness
+struct BlackbodyColor {
+    static constexpr GLfloat HOT[3] = {1.6f, 1.1f, 0.5f};
+    static constexpr GLfloat COLD[3] = {0.7f, 0.12f, 0.02f};
+
+    static glm::vec4 Evaluate(const Particle& particle, const std::vector<glm::vec3>& palette)
+    {
+        const GLfloat age = particle.GetAge();
+        const glm::vec3 color(HOT[0] + (COLD[0] - HOT[0]) * age,
+                              HOT[1] + (COLD[1] - HOT[1]) * age,
+                              HOT[2] + (COLD[2] - HOT[2]) * age);
+        return glm::vec4(color * palette[particle.GetColor()], particle.GetAlpha());
+    }
+};
+// }}}
+
+// Scale models {{{
+
+struct ShrinkScale {
+    static GLfloat Evaluate(const Particle& particle) { return particle.GetScale(); }
+};
+
+struct ConstantScale {
+    static GLfloat Evaluate(const Particle& particle) { return particle.GetSpawnScale(); }
+};
+// }}}
+
+// Emission shapes: emitter-space spawn points {{{
+
+// Gaussian blob around the emitter, stddev of a quarter radius
+struct BlobShape {
+    static constexpr GLfloat Y_OFFSET = 0.4f;
+
+    static void Generate(size_t n, const SpawnContext& context, std::vector<glm::vec3>& out)
+    {
+        const GLfloat deviation = context.radius / 4;
+        for (size_t i = 0; i < n; ++i) {
+            ParticleRandom random(context.seed, context.frame, context.Slot(i), POSITION_CHANNEL);
+            const GLfloat x = random.Normal(0.0f, deviation);
+            const GLfloat y = random.Uniform(0.0f, Y_OFFSET);
+            const GLfloat z = random.Normal(0.0f, deviation);
+            out.push_back(glm::vec3(x, y, z) + context.offset);
+        }
+    }
+};
+
+// Uniform over the surface of the emission mesh
+struct SurfaceShape {
+    static void Generate(size_t n, const SpawnContext& context, std::vector<glm::vec3>& out)
+    {
+        thread_local std::vector<GLfloat> uniforms;
+        uniforms.resize(4 * n);
+        for (size_t i = 0; i < n; ++i) {
+            ParticleRandom random(context.seed, context.frame, context.Slot(i), POSITION_CHANNEL);
+            for (size_t j = 0; j < 4; ++j) {
+                uniforms[4 * i + j] = random.Uniform();
+            }
+        }
+        const size_t first = out.size();
+        context.surface->Sample(n, uniforms.data(), context.surfaceTransform, out);
+        // surface points come out in world space
+        for (size_t i = first; i < out.size(); ++i) {
+            out[i] += context.offset - context.origin;
+        }
+    }
+};
+// }}}
+
+// Effects: policies plus spawn distributions {{{
+
+struct FireEffect {
+    using Force = FluidForce;
+    using Color = PaletteColor;
+    using Scale = ShrinkScale;
+    static constexpr GLfloat VELOCITY_LOW = 0.5f;
+    static constexpr GLfloat VELOCITY_HIGH = 1.5f;
+    static constexpr GLfloat LIFE_MEAN = 3.0f;
+    static constexpr GLfloat LIFE_DEVIATION = 1.0f;
+    static constexpr GLfloat SCALE_MEAN = 0.05f;
+    static constexpr GLfloat SCALE_DEVIATION = 0.025f;
+};
+
+struct SparkEffect {
+    using Force = BallisticForce;
+    using Color = BlackbodyColor;
+    using Scale = ConstantScale;
+    static constexpr GLfloat VELOCITY_LOW = 1.0f;
+    static constexpr GLfloat VELOCITY_HIGH = 2.5f;
+    static constexpr GLfloat LIFE_MEAN = 0.8f;
+    static constexpr GLfloat LIFE_DEVIATION = 0.3f;
+    static constexpr GLfloat SCALE_MEAN = 0.015f;
+    static constexpr GLfloat SCALE_DEVIATION = 0.005f;
+};
+
+struct EmberEffect {
+    using Force = FluidForce;
+    using Color = BlackbodyColor;
+    using Scale = ShrinkScale;
+    static constexpr GLfloat VELOCITY_LOW = 0.2f;
+    static constexpr GLfloat VELOCITY_HIGH = 0.6f;
+    static constexpr GLfloat LIFE_MEAN = 5.0f;
+    static constexpr GLfloat LIFE_DEVIATION = 1.5f;
+    static constexpr GLfloat SCALE_MEAN = 0.02f;
+    static constexpr GLfloat SCALE_DEVIATION = 0.008f;
+};
+// }}}
+
+template <class Effect, class Shape, bool kTurbulence, bool kCollide>
+class SpecializedKernel final : public EmitterKernel {
+public:
+    void Spawn(size_t n, const SpawnContext& context, std::vector<Particle>& out) const override
+    {
+        // positions are drawn as one batch
+        thread_local std::vector<glm::vec3> positions;
+        positions.clear();
+        Shape::Generate(n, context, positions);
+
+        const GLuint nColors = std::max(context.nColors, 1u);
+        // pick one of the sprites, all of them share one texture bind
+        const GLuint nLayers = std::clamp(context.nLayers, 1u, 256u);
+        // a shape may come up with fewer positions than asked for
+        for (size_t i = 0; i < positions.size(); ++i) {
+            ParticleRandom random(context.seed, context.frame, context.Slot(i), ATTRIBUTE_CHANNEL);
+            const glm::vec3 velocity = context.velocity * random.Uniform(Effect::VELOCITY_LOW, Effect::VELOCITY_HIGH);
+            const GLubyte color = random.Below(nColors);
+            const GLfloat fLife = random.Normal(Effect::LIFE_MEAN, Effect::LIFE_DEVIATION);
+            const GLfloat fScale = random.Normal(Effect::SCALE_MEAN, Effect::SCALE_DEVIATION);
+            const GLubyte layer = random.Below(nLayers);
+            if (context.events) {
+                // Particle negates the velocity it is given
+                const ParticleEvent& event = context.events[i / context.perEvent];
+                out.push_back(Particle(positions[i] + event.position - context.origin,
+                                       velocity - event.velocity * EVENT_VELOCITY_SHARE, color,
+                                       fLife, fScale, layer));
+                continue;
+            }
+            out.push_back(Particle(positions[i], velocity, color, fLife, fScale, layer));
+        }
+    }
+
+    void Update(Particle* particles, size_t count, GLfloat dt,
+                const ParticleContext& context) const override
+    {
+        for (size_t i = 0; i < count; ++i) {
+            Particle& particle = particles[i];
+            const bool alive = particle.IsAlive();
+            if (!particle.Age(dt)) {
+                if (alive && context.events) {
+                    context.events->push_back({context.origin + particle.GetPosition(),
+                                               particle.GetVelocity(), ParticleEvent::Type::death});
+                }
+                continue;
+            }
+            glm::vec3 drift(0.0f);
+            if constexpr (kTurbulence) {
+                drift = context.turbulence.Sample(particle.GetPosition());
+            }
+            particle.Advance(dt, drift);
+            particle.AddVelocity(Effect::Force::Delta(dt, particle, context));
+            if constexpr (kCollide) {
+                if (!particle.Collide(context.origin, context.collider) && context.events) {
+                    context.events->push_back({context.origin + particle.GetPosition(),
+                                               particle.GetVelocity(), ParticleEvent::Type::collision});
+                }
+            }
+        }
+    }
+
+    void Fill(const Particle* particles, size_t count, const std::vector<glm::vec3>& palette,
+              glm::vec3* offsets, glm::vec4* colors, GLfloat* scales) const override
+    {
+        for (size_t i = 0; i < count; ++i) {
+            const Particle& particle = particles[i];
+            offsets[i] = particle.GetPosition();
+            colors[i] = Effect::Color::Evaluate(particle, palette);
+            // dead particles inside the window collapse to nothing
+            scales[i] = particle.IsAlive() ? Effect::Scale::Evaluate(particle) : 0.0f;
+        }
+    }
+};
+
+template <class Effect, class Shape, bool kTurbulence, bool kCollide>
+const EmitterKernel* Instance()
+{
+    static const SpecializedKernel<Effect, Shape, kTurbulence, kCollide> kernel;
+    return &kernel;
+}
+
+// Runtime flags to template arguments, one level per flag
+template <class Effect, class Shape, bool kTurbulence>
+const EmitterKernel* Specialize(bool collide)
+{
+    if (collide)
+        return Instance<Effect, Shape, kTurbulence, true>();
+    return Instance<Effect, Shape, kTurbulence, false>();
+}
+
+template <class Effect, class Shape>
+const EmitterKernel* Specialize(bool turbulence, bool collide)
+{
+    if (turbulence)
+        return Specialize<Effect, Shape, true>(collide);
+    return Specialize<Effect, Shape, false>(collide);
+}
+
+template <class Effect>
+const EmitterKernel* Specialize(bool surface, bool turbulence, bool collide)
+{
+    if (surface)
+        return Specialize<Effect, SurfaceShape>(turbulence, collide);
+    return Specialize<Effect, BlobShape>(turbulence, collide);
+}
+
+} // namespace
+
+const EmitterKernel* EmitterKernel::Create(EmitterEffect effect, bool surface, bool turbulence,
+                                           bool collide)
+{
+    switch (effect) {
+    case EmitterEffect::sparks:
+        return Specialize<SparkEffect>(surface, turbulence, collide);
+    case EmitterEffect::embers:
+        return Specialize<EmberEffect>(surface, turbulence, collide);
+    case EmitterEffect::fire:
+    default:
+        return Specialize<FireEffect>(surface, turbulence, collide);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "curl_noise.h"
+#include "fluid_grid.h"
+#include "mesh.h"
+#include "particle.h"
+#include "sdf.h"
+
+// Particle presets, each one fixes the force, color and scale model
+// plus the spawn distributions of an emitter
+enum class EmitterEffect {
+    // carried by the fluid, grey sprites shrinking and fading out
+    fire,
+    // fast and short-lived, falling under gravity, blackbody colors
+    sparks,
+    // slow glowing bits carried by the fluid for a long time
+    embers
+};
+
+// A particle that died of age or was killed by the collider during an
+// update. Sub-emitters spawn from these, see EmitterManager::SetSubEmitter
+struct ParticleEvent {
+    enum class Type : uint8_t { death, collision };
+
+    // world space
+    glm::vec3 position;
+    glm::vec3 velocity;
+    Type type;
+};
+
+// Per-emitter state shared by all of its particles during an update
+struct ParticleContext {
+    const FluidGrid& fluid;
+    // emitter world position, particle positions are emitter-local
+    glm::vec3 origin;
+    // launch direction of the emitter
+    glm::vec3 direction;
+    const Turbulence& turbulence;
+    const Collider& collider;
+    // appended to by the update, nullptr records no events. Owned by the
+    // emitter, so only the thread updating it writes there
+    std::vector<ParticleEvent>* events;
+};
+
+// Per-emitter state for spawning a batch of particles. Particle i of the
+// batch draws its random numbers from ParticleRandom(seed, frame, Slot(i)),
+// so a batch comes out the same however it is split between threads
+struct SpawnContext {
+    uint64_t seed;
+    // Update count of the emitter
+    uint32_t frame;
+    // ring slot of the first particle of the batch and the ring size
+    size_t firstSlot;
+    size_t capacity;
+    // emitter world position, spawn points are emitter-local
+    glm::vec3 origin;
+    // added to every spawn point
+    glm::vec3 offset;
+    // passed to Particle scaled by the effect's velocity range, particles
+    // are emitted against it
+    glm::vec3 velocity;
+    GLfloat radius;
+    // world space, nullptr spawns in the blob around the emitter
+    const SurfaceSampler* surface;
+    glm::mat4 surfaceTransform;
+    GLuint nColors;
+    GLuint nLayers;
+    // sub-emitter spawns: particles [i * perEvent, (i + 1) * perEvent)
+    // start around events[i] and inherit part of its velocity. nullptr
+    // for regular spawns
+    const ParticleEvent* events;
+    size_t perEvent;
+
+    uint32_t Slot(size_t i) const { return (firstSlot + i) % capacity; }
+};
+
+// Update loop of one combination of effect, emission shape and optional
+// passes, compiled without branches on any of them. Emitters pick theirs
+// once through Create, the virtual call is per batch, not per particle.
+// Kernels are stateless, one instance per combination is shared
+class EmitterKernel {
+public:
+    virtual ~EmitterKernel() = default;
+
+    // Appends n new particles to out
+    virtual void Spawn(size_t n, const SpawnContext& context, std::vector<Particle>& out) const = 0;
+    // Ages and moves count particles
+    virtual void Update(Particle* particles, size_t count, GLfloat dt,
+                        const ParticleContext& context) const = 0;
+    // Writes the render attributes of count particles, dead ones get scale 0
+    virtual void Fill(const Particle* particles, size_t count,
+                      const std::vector<glm::vec3>& palette, glm::vec3* offsets,
+                      glm::vec4* colors, GLfloat* scales) const = 0;
+
+    // surface selects mesh emission, turbulence and collide compile the
+    // curl noise and collider passes in
+    static const EmitterKernel* Create(EmitterEffect effect, bool surface, bool turbulence,
+                                       bool collide);
+};
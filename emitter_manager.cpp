@@ -0,0 +1,274 @@
+#include "emitter_manager.h"
+
+#include <algorithm>
+
+#define MIN_CAPACITY 1024
+
+// projected emitter radius in pixels from which on the emitter updates
+// every particle every frame, a half, a quarter or an eighth of them
+#define LOD_FULL_PIXELS 96.0f
+#define LOD_HALF_PIXELS 32.0f
+#define LOD_QUARTER_PIXELS 12.0f
+
+EmitterManager::EmitterManager(size_t maxPooledPerClass)
+    : m_nEmitters(0),
+      m_maxPooledPerClass(maxPooledPerClass),
+      m_nPooled(0),
+      m_nCreated(0),
+      m_nReused(0)
+{
+}
+
+EmitterManager::~EmitterManager()
+{
+    for (auto& storageClass : m_pool) {
+        for (auto& storage : storageClass.second) {
+            storage.Release();
+        }
+    }
+}
+
+size_t EmitterManager::CapacityClass(size_t amount)
+{
+    size_t capacity = MIN_CAPACITY;
+    while (capacity < amount) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+GLuint EmitterManager::LodGroups(GLfloat pixels)
+{
+    if (pixels >= LOD_FULL_PIXELS)
+        return 1;
+    if (pixels >= LOD_HALF_PIXELS)
+        return 2;
+    if (pixels >= LOD_QUARTER_PIXELS)
+        return 4;
+    return Emitter::MAX_UPDATE_GROUPS;
+}
+
+EmitterHandle EmitterManager::Create(const Shader& shader,
+                                     const Texture2DArray& texture,
+                                     const glm::vec3& position,
+                                     const glm::vec3& direction,
+                                     GLfloat radius,
+                                     GLfloat energy,
+                                     GLfloat velocity,
+                                     GLuint amount,
+                                     EmitterMode mode,
+                                     EmitterEffect effect)
+{
+    // 1. Storage from the pool, or an empty one the emitter fills
+    // at the class capacity
+    EmitterStorage storage;
+    std::vector<EmitterStorage>& pooled = m_pool[{mode, CapacityClass(amount)}];
+    if (!pooled.empty()) {
+        storage = std::move(pooled.back());
+        pooled.pop_back();
+        --m_nPooled;
+        ++m_nReused;
+    } else {
+        storage.mode = mode;
+        storage.capacity = CapacityClass(amount);
+        ++m_nCreated;
+    }
+
+    // 2. A free slot, the generation tells old handles apart
+    GLuint index;
+    if (!m_freeSlots.empty()) {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        index = m_slots.size();
+        m_slots.emplace_back();
+    }
+    Slot& slot = m_slots[index];
+    slot.emitter.reset(new Emitter(shader, texture, position, direction, radius, energy,
+                                   velocity, amount, mode, effect, std::move(storage)));
+    slot.nNewParticles = 0;
+    slot.nBurst = 0;
+    slot.offset = glm::vec3(0.0f);
+    slot.sub = SubEmitter();
+    ++m_nEmitters;
+    return {index, slot.generation};
+}
+
+EmitterManager::Slot* EmitterManager::Find(EmitterHandle handle)
+{
+    if (handle.index >= m_slots.size()) {
+        return nullptr;
+    }
+    Slot& slot = m_slots[handle.index];
+    return slot.emitter && slot.generation == handle.generation ? &slot : nullptr;
+}
+
+Emitter* EmitterManager::Get(EmitterHandle handle) const
+{
+    if (handle.index >= m_slots.size() || m_slots[handle.index].generation != handle.generation) {
+        return nullptr;
+    }
+    return m_slots[handle.index].emitter.get();
+}
+
+void EmitterManager::SetEmission(EmitterHandle handle, GLuint nNewParticles, const glm::vec3& offset)
+{
+    if (Slot* slot = Find(handle)) {
+        slot->nNewParticles = nNewParticles;
+        slot->offset = offset;
+    }
+}
+
+void EmitterManager::Burst(EmitterHandle handle, GLuint nParticles)
+{
+    if (Slot* slot = Find(handle)) {
+        slot->nBurst += nParticles;
+    }
+}
+
+void EmitterManager::Extinguish(EmitterHandle handle)
+{
+    if (Slot* slot = Find(handle)) {
+        slot->emitter->Extinguish();
+    }
+}
+
+void EmitterManager::SetSubEmitter(EmitterHandle parent, EmitterHandle child, ParticleEvent::Type type,
+                                   GLuint perEvent, GLuint every)
+{
+    if (Slot* slot = Find(parent)) {
+        slot->sub = {child, type, perEvent, std::max(every, 1u), 0};
+        slot->emitter->SetEventCapture(perEvent > 0);
+    }
+}
+
+bool EmitterManager::HasSubEmitters() const
+{
+    return std::any_of(m_slots.begin(), m_slots.end(), [](const Slot& slot) {
+        return slot.emitter && slot.sub.perEvent > 0;
+    });
+}
+
+void EmitterManager::SpawnSubEmitters()
+{
+    // 1. Gather the events per child, in parent slot order
+    m_subEvents.resize(m_slots.size());
+    for (auto& slot : m_slots) {
+        if (!slot.emitter || slot.sub.perEvent == 0 || !Find(slot.sub.child)) {
+            continue;
+        }
+        std::vector<ParticleEvent>& events = m_subEvents[slot.sub.child.index];
+        for (const ParticleEvent& event : slot.emitter->GetEvents()) {
+            if (event.type == slot.sub.type && slot.sub.nEvents++ % slot.sub.every == 0) {
+                events.insert(events.end(), slot.sub.perEvent, event);
+            }
+        }
+    }
+
+    // 2. One spawn per child
+    for (GLuint i = 0; i < m_slots.size(); ++i) {
+        std::vector<ParticleEvent>& events = m_subEvents[i];
+        if (!events.empty()) {
+            m_slots[i].emitter->SpawnAt(events.data(), events.size(), 1);
+            events.clear();
+        }
+    }
+}
+
+void EmitterManager::Update(GLfloat dt, FluidGrid& fluid)
+{
+    for (auto& slot : m_slots) {
+        if (slot.emitter) {
+            slot.emitter->Update(dt, slot.nNewParticles + slot.nBurst, fluid, slot.offset);
+            slot.nBurst = 0;
+        }
+    }
+    AddHeat(dt, fluid);
+    Retire();
+}
+
+void EmitterManager::UpdateEmitter(EmitterHandle handle, GLfloat dt, const FluidGrid& fluid)
+{
+    if (Slot* slot = Find(handle)) {
+        slot->emitter->Update(dt, slot->nNewParticles + slot->nBurst, fluid, slot->offset);
+        slot->nBurst = 0;
+    }
+}
+
+void EmitterManager::AddHeat(GLfloat dt, FluidGrid& fluid) const
+{
+    // in slot order, the fluid sees the same sums every run
+    for (const auto& slot : m_slots) {
+        if (slot.emitter) {
+            slot.emitter->AddHeat(fluid, dt, slot.offset);
+        }
+    }
+}
+
+void EmitterManager::Retire()
+{
+    for (GLuint i = 0; i < m_slots.size(); ++i) {
+        Slot& slot = m_slots[i];
+        // out of energy and the last particle is gone
+        if (slot.emitter && !slot.emitter->IsAlive() && slot.emitter->GetParticleCount() == 0) {
+            RetireSlot(slot, i);
+        }
+    }
+}
+
+void EmitterManager::RetireSlot(Slot& slot, GLuint index)
+{
+    EmitterStorage storage = slot.emitter->ReleaseStorage();
+    slot.emitter.reset();
+    ++slot.generation;
+    m_freeSlots.push_back(index);
+    --m_nEmitters;
+
+    std::vector<EmitterStorage>& pooled = m_pool[{storage.mode, storage.capacity}];
+    if (pooled.size() < m_maxPooledPerClass) {
+        pooled.push_back(std::move(storage));
+        ++m_nPooled;
+    } else {
+        storage.Release();
+    }
+}
+
+void EmitterManager::Draw()
+{
+    for (auto& slot : m_slots) {
+        if (slot.emitter) {
+            slot.emitter->Draw();
+        }
+    }
+}
+
+void EmitterManager::UpdateLod(const glm::vec3& eye, GLfloat pixelsPerUnit)
+{
+    for (auto& slot : m_slots) {
+        if (slot.emitter) {
+            const glm::vec3 center = slot.emitter->GetPosition() + slot.offset;
+            const GLfloat distance = std::max(glm::length(center - eye), 0.01f);
+            const GLfloat pixels = slot.emitter->GetRadius() * pixelsPerUnit / distance;
+            slot.emitter->SetUpdateGroups(LodGroups(pixels));
+        }
+    }
+}
+
+void EmitterManager::GetHandles(std::vector<EmitterHandle>& handles) const
+{
+    for (GLuint i = 0; i < m_slots.size(); ++i) {
+        if (m_slots[i].emitter) {
+            handles.push_back({i, m_slots[i].generation});
+        }
+    }
+}
+
+size_t EmitterManager::GetEmitterCount() const
+{
+    return m_nEmitters;
+}
+
+size_t EmitterManager::GetPooledCount() const
+{
+    return m_nPooled;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "emitter.h"
+#include "fluid_grid.h"
+
+// Refers to an emitter of an EmitterManager. Retired emitters leave their
+// handles dangling safely, Get returns nullptr for them
+struct EmitterHandle {
+    GLuint index = 0;
+    // 0 is never handed out
+    GLuint generation = 0;
+};
+
+// Owns emitters from ignition to their last particle. Update ticks all of
+// them; extinguished ones burn out and are retired once empty. Retired
+// storage goes into a pool keyed by mode and capacity class (amount
+// rounded up to a power of two), and new emitters take it from there, so
+// once the pool is warm an ignition creates no GL objects and allocates
+// no particle storage
+class EmitterManager {
+public:
+    explicit EmitterManager(size_t maxPooledPerClass = 32);
+    // Frees the pooled storage, live emitters free their own
+    ~EmitterManager();
+
+    EmitterManager(const EmitterManager&) = delete;
+    EmitterManager& operator=(const EmitterManager&) = delete;
+
+    // Same arguments as the Emitter constructor. The emitter spawns
+    // nothing until SetEmission
+    EmitterHandle Create(const Shader& shader,
+                         const Texture2DArray& texture,
+                         const glm::vec3& position,
+                         const glm::vec3& direction,
+                         GLfloat radius,
+                         GLfloat energy,
+                         GLfloat velocity,
+                         GLuint amount,
+                         EmitterMode mode = EmitterMode::simulated,
+                         EmitterEffect effect = EmitterEffect::fire);
+    // For configuration, nullptr once the emitter retired
+    Emitter* Get(EmitterHandle handle) const;
+    // Particles spawned per Update and the spawn offset, see Emitter::Update
+    void SetEmission(EmitterHandle handle, GLuint nNewParticles,
+                     const glm::vec3& offset = glm::vec3(0.0f));
+    // Spawns nParticles once with the next update, on top of the emission
+    void Burst(EmitterHandle handle, GLuint nParticles);
+    // Stops spawning, the emitter retires after its last particle
+    void Extinguish(EmitterHandle handle);
+    // Makes child spawn perEvent particles around every every-th event of
+    // the given type of parent, see Emitter::SpawnAt. A child may serve
+    // several parents, perEvent 0 removes the link
+    void SetSubEmitter(EmitterHandle parent, EmitterHandle child, ParticleEvent::Type type,
+                       GLuint perEvent = 1, GLuint every = 1);
+    bool HasSubEmitters() const;
+
+    // Updates every emitter, adds their heat and retires the burnt out
+    // ones. Same as the three steps below
+    void Update(GLfloat dt, FluidGrid& fluid);
+    // Updates one emitter, different ones may update in parallel
+    void UpdateEmitter(EmitterHandle handle, GLfloat dt, const FluidGrid& fluid);
+    void AddHeat(GLfloat dt, FluidGrid& fluid) const;
+    // Batched spawn of all sub-emitters from the events of the last
+    // updates, after every emitter updated and before any of them draws.
+    // One SpawnAt per child
+    void SpawnSubEmitters();
+    void Retire();
+    void Draw();
+    // Simulation LOD of every emitter from its projected size, the emitter
+    // radius over its distance to eye. pixelsPerUnit is the screen size
+    // of one unit at distance 1, see Emitter::SetUpdateGroups
+    void UpdateLod(const glm::vec3& eye, GLfloat pixelsPerUnit);
+
+    // Appends the handles of all emitters
+    void GetHandles(std::vector<EmitterHandle>& handles) const;
+    size_t GetEmitterCount() const;
+    size_t GetPooledCount() const;
+    // storage created from scratch and taken from the pool so far
+    size_t GetCreatedCount() const { return m_nCreated; }
+    size_t GetReusedCount() const { return m_nReused; }
+
+    // Smallest power of two holding amount particles, at least 1024
+    static size_t CapacityClass(size_t amount);
+    // Update groups of an emitter whose radius covers pixels on screen
+    static GLuint LodGroups(GLfloat pixels);
+
+private:
+    struct SubEmitter {
+        EmitterHandle child;
+        ParticleEvent::Type type = ParticleEvent::Type::death;
+        // 0 for no sub-emitter
+        GLuint perEvent = 0;
+        GLuint every = 1;
+        // events of the type so far, picks every-th across updates
+        size_t nEvents = 0;
+    };
+
+    struct Slot {
+        std::unique_ptr<Emitter> emitter;
+        GLuint generation = 1;
+        GLuint nNewParticles = 0;
+        // one-off, see Burst
+        GLuint nBurst = 0;
+        glm::vec3 offset = glm::vec3(0.0f);
+        SubEmitter sub;
+    };
+
+    Slot* Find(EmitterHandle handle);
+    void RetireSlot(Slot& slot, GLuint index);
+
+    std::vector<Slot> m_slots;
+    std::vector<GLuint> m_freeSlots;
+    // per child slot, scratch of SpawnSubEmitters
+    std::vector<std::vector<ParticleEvent>> m_subEvents;
+    size_t m_nEmitters;
+
+    std::map<std::pair<EmitterMode, size_t>, std::vector<EmitterStorage>> m_pool;
+    const size_t m_maxPooledPerClass;
+    size_t m_nPooled;
+    size_t m_nCreated;
+    size_t m_nReused;
+};
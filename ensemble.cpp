@@ -0,0 +1,275 @@
+// Headless ensemble: plays every combination of a parameter grid over a
+// base scenario, several seeds each, on all cores and writes one CSV row
+// per run.
+//
+//   fire_ensemble <grid file> [-o results.csv] [-n runs per batch]
+//
+// Grid files use the scenario syntax, one setting per line:
+//
+//   scenario  fire_default.scn   base scenario, relative to the grid file
+//   radius    1 2 3              values to sweep, applied to every emitter
+//   energy    2 5                of the base scenario; settings left out
+//   velocity  5 7 9              keep the base values
+//   rate      100 300
+//   repeats   4                  seeds per combination
+//   sample    0.25               seconds between trace samples
+//
+// Runs are independent tasks of a TaskGraph, so workers steal from each
+// other and runs of uneven length don't leave cores idle. Only one batch
+// of runs is alive at a time, which bounds the memory. Exit code 2 means
+// bad input.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "scenario.h"
+#include "task_graph.h"
+
+#define DEFAULT_SAMPLE 0.25f
+// runs per batch and thread
+#define BATCH_PER_THREAD 8
+
+namespace {
+
+struct Grid {
+    std::string scenario;
+    std::vector<GLfloat> radius;
+    std::vector<GLfloat> energy;
+    std::vector<GLfloat> velocity;
+    std::vector<GLuint> rate;
+    size_t repeats = 1;
+    GLfloat sample = DEFAULT_SAMPLE;
+};
+
+// Parameters of one run, the grid point and its seed. Settings the grid
+// leaves out are empty, the emitters keep their own values
+struct Run {
+    size_t index;
+    unsigned seed;
+    std::optional<GLfloat> radius;
+    std::optional<GLfloat> energy;
+    std::optional<GLfloat> velocity;
+    std::optional<GLuint> rate;
+    ScenarioResult result;
+};
+
+template <typename T>
+bool ParseValues(std::istringstream& tokens, std::vector<T>& values)
+{
+    values.clear();
+    T value;
+    while (tokens >> value) {
+        values.push_back(value);
+    }
+    return tokens.eof() && !values.empty();
+}
+
+bool LoadGrid(const std::string& file, Grid& grid)
+{
+    std::ifstream stream(file);
+    if (!stream) {
+        std::cout << "Failed to load grid at path: " << file << std::endl;
+        return false;
+    }
+    const size_t slash = file.find_last_of('/');
+    const std::string directory = slash == std::string::npos ? "" : file.substr(0, slash + 1);
+
+    std::string line;
+    for (size_t nLine = 1; std::getline(stream, line); ++nLine) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword)) {
+            continue;
+        }
+
+        bool ok = true;
+        if (keyword == "scenario") {
+            ok = static_cast<bool>(tokens >> grid.scenario);
+            grid.scenario = directory + grid.scenario;
+        } else if (keyword == "radius") {
+            ok = ParseValues(tokens, grid.radius);
+        } else if (keyword == "energy") {
+            ok = ParseValues(tokens, grid.energy);
+        } else if (keyword == "velocity") {
+            ok = ParseValues(tokens, grid.velocity);
+        } else if (keyword == "rate") {
+            ok = ParseValues(tokens, grid.rate);
+        } else if (keyword == "repeats") {
+            ok = static_cast<bool>(tokens >> grid.repeats) && grid.repeats > 0;
+        } else if (keyword == "sample") {
+            ok = static_cast<bool>(tokens >> grid.sample) && grid.sample >= 0.0f;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cout << "ERROR::ENSEMBLE: " << file << ":" << nLine << ": invalid line: " << line
+                      << std::endl;
+            return false;
+        }
+    }
+    if (grid.scenario.empty()) {
+        std::cout << "ERROR::ENSEMBLE: " << file << ": no scenario" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Value of a swept setting at the grid point, point moves on to the next
+// setting. Empty if the grid leaves the setting out
+template <typename T>
+std::optional<T> Pick(const std::vector<T>& values, size_t& point)
+{
+    if (values.empty()) {
+        return std::nullopt;
+    }
+    const T value = values[point % values.size()];
+    point /= values.size();
+    return value;
+}
+
+// The run-th combination, repeats of one grid point are adjacent
+Run MakeRun(const Grid& grid, const Scenario& base, size_t index)
+{
+    Run run = {};
+    run.index = index;
+    // distinct emitter streams for every run
+    run.seed = base.seed + index;
+    size_t point = index / grid.repeats;
+    run.rate = Pick(grid.rate, point);
+    run.velocity = Pick(grid.velocity, point);
+    run.energy = Pick(grid.energy, point);
+    run.radius = Pick(grid.radius, point);
+    return run;
+}
+
+size_t RunCount(const Grid& grid)
+{
+    return std::max<size_t>(grid.radius.size(), 1) * std::max<size_t>(grid.energy.size(), 1) *
+           std::max<size_t>(grid.velocity.size(), 1) * std::max<size_t>(grid.rate.size(), 1) *
+           grid.repeats;
+}
+
+void Play(const Scenario& base, GLfloat sample, Run& run)
+{
+    Scenario scenario = base;
+    scenario.seed = run.seed;
+    scenario.sample = sample;
+    for (EmitterSpec& spec : scenario.emitters) {
+        spec.radius = run.radius.value_or(spec.radius);
+        spec.energy = run.energy.value_or(spec.energy);
+        spec.velocity = run.velocity.value_or(spec.velocity);
+        spec.rate = run.rate.value_or(spec.rate);
+    }
+    run.result = RunScenario(scenario);
+}
+
+void WriteHeader(std::ostream& stream)
+{
+    stream << "run,seed,radius,energy,velocity,rate,steps,mean_step_ms,p99_step_ms,"
+              "particles_per_s,final_particles,peak_plume_height,live_counts,plume_heights\n";
+}
+
+// Settings the grid leaves out are written as the base values of the
+// first emitter
+void WriteRow(std::ostream& stream, const Run& run, const Scenario& base)
+{
+    const ScenarioResult& result = run.result;
+    const EmitterSpec& first = base.emitters.front();
+    stream << run.index << "," << run.seed << "," << run.radius.value_or(first.radius) << ","
+           << run.energy.value_or(first.energy) << "," << run.velocity.value_or(first.velocity)
+           << "," << run.rate.value_or(first.rate) << "," << result.nSteps << "," << result.meanStepMs
+           << "," << result.p99StepMs << "," << result.throughput << "," << result.finalParticles
+           << "," << result.peakPlumeHeight << ",";
+    // curves as ';' separated lists, one CSV field each
+    for (size_t i = 0; i < result.liveCounts.size(); ++i) {
+        stream << (i ? ";" : "") << result.liveCounts[i];
+    }
+    stream << ",";
+    for (size_t i = 0; i < result.plumeHeights.size(); ++i) {
+        stream << (i ? ";" : "") << result.plumeHeights[i];
+    }
+    stream << "\n";
+}
+
+int Usage()
+{
+    std::cout << "usage: fire_ensemble <grid file> [-o results.csv] [-n runs per batch]" << std::endl;
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string gridFile;
+    std::string output = "ensemble.csv";
+    size_t batchSize = 0;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "-n" && i + 1 < argc)
+            batchSize = std::strtoul(argv[++i], nullptr, 10);
+        else if (gridFile.empty() && arg[0] != '-')
+            gridFile = arg;
+        else
+            return Usage();
+    }
+    if (gridFile.empty()) {
+        return Usage();
+    }
+
+    Grid grid;
+    Scenario base;
+    if (!LoadGrid(gridFile, grid) || !Scenario::Load(grid.scenario, base)) {
+        return 2;
+    }
+    std::ofstream stream(output);
+    if (!stream) {
+        std::cout << "ERROR::ENSEMBLE: Failed to write results: " << output << std::endl;
+        return 2;
+    }
+    WriteHeader(stream);
+
+    TaskScheduler& scheduler = TaskScheduler::Instance();
+    if (batchSize == 0) {
+        batchSize = (scheduler.Size() + 1) * BATCH_PER_THREAD;
+    }
+    const size_t nRuns = RunCount(grid);
+    std::cout << base.name << ": " << nRuns << " runs in batches of " << batchSize << " on "
+              << scheduler.Size() + 1 << " threads" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Run> runs;
+    TaskGraph graph;
+    for (size_t first = 0; first < nRuns; first += batchSize) {
+        // 1. One task per run, any order
+        runs.clear();
+        graph.Clear();
+        for (size_t index = first; index < std::min(first + batchSize, nRuns); ++index) {
+            runs.push_back(MakeRun(grid, base, index));
+        }
+        for (Run& run : runs) {
+            graph.Add("run", [&base, &grid, &run]() { Play(base, grid.sample, run); });
+        }
+        graph.Run(scheduler);
+
+        // 2. Rows in run order, then the batch is gone
+        for (const Run& run : runs) {
+            WriteRow(stream, run, base);
+        }
+        stream.flush();
+        std::cout << first + runs.size() << "/" << nRuns << " runs" << std::endl;
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Results written to " << output << " in " << seconds << " s" << std::endl;
+    return stream ? 0 : 2;
+}
@@ -0,0 +1,237 @@
+#include "fire_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+
+#define AMBIENT_TEMPERATURE 0.0f
+#define IGNITION_TEMPERATURE 1.0f
+#define FLAME_TEMPERATURE 6.0f
+// blocks cooler than this everywhere leave the frontier
+#define WARM_TEMPERATURE 0.05f
+// fraction of the difference to the neighbours exchanged per second
+#define HEAT_DIFFUSION 1.5f
+// extra inflow from a hotter cell below, heat rises
+#define UPDRAFT 2.0f
+#define COOLING_RATE 0.4f
+#define BURN_RATE 1.0f
+
+namespace {
+
+// index 2 is the cell below
+const glm::ivec3 FACE_NEIGHBOURS[6] = {
+    glm::ivec3(-1, 0, 0), glm::ivec3(1, 0, 0), glm::ivec3(0, -1, 0),
+    glm::ivec3(0, 1, 0), glm::ivec3(0, 0, -1), glm::ivec3(0, 0, 1)};
+
+} // namespace
+
+static_assert(FireGrid::BLOCK_SIZE == 1 << FireGrid::BLOCK_SHIFT, "blocks are a power of two");
+
+FireGrid::FireGrid(const glm::ivec3& resolution, GLfloat cellSize, const glm::vec3& origin)
+    : m_resolution(resolution),
+      m_cellSize(cellSize),
+      m_origin(origin),
+      m_blockResolution((resolution + BLOCK_SIZE - 1) / BLOCK_SIZE),
+      m_step(0)
+{
+    m_blockTable.assign(static_cast<size_t>(m_blockResolution.x) * m_blockResolution.y *
+                            m_blockResolution.z, -1);
+}
+
+int32_t FireGrid::FindBlock(const glm::ivec3& coord) const
+{
+    if (coord.x < 0 || coord.y < 0 || coord.z < 0 || coord.x >= m_blockResolution.x ||
+        coord.y >= m_blockResolution.y || coord.z >= m_blockResolution.z) {
+        return -1;
+    }
+    return m_blockTable[(static_cast<size_t>(coord.z) * m_blockResolution.y + coord.y) *
+                            m_blockResolution.x + coord.x];
+}
+
+GLuint FireGrid::AllocateBlock(const glm::ivec3& coord)
+{
+    const int32_t existing = FindBlock(coord);
+    if (existing >= 0) {
+        return existing;
+    }
+    Block block;
+    block.coord = coord;
+    std::fill(std::begin(block.fuel), std::end(block.fuel), 0.0f);
+    std::fill(std::begin(block.temperature), std::end(block.temperature), AMBIENT_TEMPERATURE);
+    std::fill(std::begin(block.temperature0), std::end(block.temperature0), AMBIENT_TEMPERATURE);
+    std::fill(std::begin(block.state), std::end(block.state), CellState::empty);
+    block.nBurning = 0;
+    block.nBurningBefore = 0;
+    block.burningSum = glm::vec3(0.0f);
+    block.maxTemperature = AMBIENT_TEMPERATURE;
+    block.active = false;
+    block.visited = 0;
+
+    const GLuint index = m_blocks.size();
+    m_blocks.push_back(block);
+    m_blockTable[(static_cast<size_t>(coord.z) * m_blockResolution.y + coord.y) *
+                     m_blockResolution.x + coord.x] = index;
+    return index;
+}
+
+void FireGrid::Activate(GLuint block)
+{
+    if (!m_blocks[block].active) {
+        m_blocks[block].active = true;
+        m_active.push_back(block);
+    }
+}
+
+void FireGrid::SetFuel(const glm::ivec3& cell, GLfloat fuel)
+{
+    if (cell.x < 0 || cell.y < 0 || cell.z < 0 || cell.x >= m_resolution.x ||
+        cell.y >= m_resolution.y || cell.z >= m_resolution.z) {
+        return;
+    }
+    Block& block = m_blocks[AllocateBlock(BlockOf(cell))];
+    const int i = CellIndex(cell - block.coord * BLOCK_SIZE);
+    block.fuel[i] = fuel;
+    block.state[i] = fuel > 0.0f ? CellState::fuel : CellState::empty;
+}
+
+void FireGrid::Ignite(const glm::vec3& position)
+{
+    const glm::ivec3 cell(glm::floor((position - m_origin) / m_cellSize));
+    const int32_t index = FindBlock(BlockOf(cell));
+    if (index < 0) {
+        return;
+    }
+    Block& block = m_blocks[index];
+    const int i = CellIndex(cell - block.coord * BLOCK_SIZE);
+    if (block.state[i] == CellState::fuel) {
+        // the next Step picks it up as burning
+        block.temperature[i] = FLAME_TEMPERATURE;
+        Activate(index);
+    }
+}
+
+GLfloat FireGrid::Temperature(const glm::ivec3& cell) const
+{
+    const int32_t index = FindBlock(BlockOf(cell));
+    if (index < 0) {
+        return AMBIENT_TEMPERATURE;
+    }
+    const glm::ivec3 local(cell.x & (BLOCK_SIZE - 1), cell.y & (BLOCK_SIZE - 1), cell.z & (BLOCK_SIZE - 1));
+    return m_blocks[index].temperature[CellIndex(local)];
+}
+
+void FireGrid::StepBlock(Block& block, GLfloat dt) const
+{
+    // explicit diffusion is stable up to a total weight of 1
+    const GLfloat exchange = std::min(HEAT_DIFFUSION * dt, 1.0f / (6.0f + UPDRAFT));
+    const GLfloat cooling = std::exp(-COOLING_RATE * dt);
+
+    block.nBurningBefore = block.nBurning;
+    block.nBurning = 0;
+    block.burningSum = glm::vec3(0.0f);
+    block.maxTemperature = AMBIENT_TEMPERATURE;
+    const glm::ivec3 base = block.coord * BLOCK_SIZE;
+    for (int z = 0; z < BLOCK_SIZE; ++z) {
+        for (int y = 0; y < BLOCK_SIZE; ++y) {
+            for (int x = 0; x < BLOCK_SIZE; ++x) {
+                const glm::ivec3 local(x, y, z);
+                const int i = CellIndex(local);
+                const GLfloat temperature = block.temperature[i];
+
+                // Gather from the neighbours, the block only writes itself
+                GLfloat flow = 0.0f;
+                for (int n = 0; n < 6; ++n) {
+                    const glm::ivec3 other = local + FACE_NEIGHBOURS[n];
+                    const bool inside = other.x >= 0 && other.y >= 0 && other.z >= 0 &&
+                                        other.x < BLOCK_SIZE && other.y < BLOCK_SIZE &&
+                                        other.z < BLOCK_SIZE;
+                    const GLfloat neighbour = inside ? block.temperature[CellIndex(other)]
+                                                     : Temperature(base + other);
+                    flow += neighbour - temperature;
+                    if (n == 2) {
+                        flow += UPDRAFT * std::max(neighbour - temperature, 0.0f);
+                    }
+                }
+                GLfloat updated = AMBIENT_TEMPERATURE +
+                                  (temperature + exchange * flow - AMBIENT_TEMPERATURE) * cooling;
+
+                CellState& state = block.state[i];
+                if (state == CellState::fuel && updated >= IGNITION_TEMPERATURE) {
+                    state = CellState::burning;
+                }
+                if (state == CellState::burning) {
+                    block.fuel[i] -= BURN_RATE * dt;
+                    if (block.fuel[i] <= 0.0f) {
+                        block.fuel[i] = 0.0f;
+                        state = CellState::burnt;
+                    } else {
+                        updated = std::max(updated, FLAME_TEMPERATURE);
+                        ++block.nBurning;
+                        block.burningSum += glm::vec3(local) + 0.5f;
+                    }
+                }
+                block.temperature0[i] = updated;
+                block.maxTemperature = std::max(block.maxTemperature, updated);
+            }
+        }
+    }
+}
+
+void FireGrid::Step(GLfloat dt)
+{
+    m_ignited.clear();
+    m_extinguished.clear();
+    ++m_step;
+
+    // 1. Frontier: active blocks plus their allocated face neighbours,
+    // which may catch the heat
+    m_frontier.clear();
+    auto visit = [this](GLuint index) {
+        if (m_blocks[index].visited != m_step) {
+            m_blocks[index].visited = m_step;
+            m_frontier.push_back(index);
+        }
+    };
+    for (GLuint index : m_active) {
+        visit(index);
+        for (const auto& offset : FACE_NEIGHBOURS) {
+            const int32_t neighbour = FindBlock(m_blocks[index].coord + offset);
+            if (neighbour >= 0) {
+                visit(neighbour);
+            }
+        }
+    }
+
+    // 2. Blocks in parallel, each reads the current temperatures and
+    // writes its own back buffer
+    ThreadPool::Instance().ParallelFor(0, m_frontier.size(), [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; ++n) {
+            StepBlock(m_blocks[m_frontier[n]], dt);
+        }
+    });
+
+    // 3. Publish the new temperatures and rebuild the active set
+    m_active.clear();
+    for (GLuint index : m_frontier) {
+        Block& block = m_blocks[index];
+        std::swap(block.temperature, block.temperature0);
+        if (block.nBurningBefore == 0 && block.nBurning > 0) {
+            m_ignited.push_back(index);
+        } else if (block.nBurningBefore > 0 && block.nBurning == 0) {
+            m_extinguished.push_back(index);
+        }
+        block.active = block.nBurning > 0 || block.maxTemperature > WARM_TEMPERATURE;
+        if (block.active) {
+            m_active.push_back(index);
+        }
+    }
+}
+
+glm::vec3 FireGrid::GetFireCenter(GLuint block) const
+{
+    const Block& b = m_blocks[block];
+    const glm::vec3 local = b.nBurning > 0 ? b.burningSum / static_cast<GLfloat>(b.nBurning)
+                                           : glm::vec3(BLOCK_SIZE / 2.0f);
+    return m_origin + (glm::vec3(b.coord * BLOCK_SIZE) + local) * m_cellSize;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// World-scale burnable voxel grid. Cells hold fuel and a temperature,
+// fuel cells ignite once hot enough, burning cells heat their neighbours
+// and consume their fuel until they are burnt out.
+// Both storage and updates are sparse: cells live in blocks of
+// BLOCK_SIZE^3 that are only allocated where fuel is placed, and Step
+// visits the blocks that burn or are still warm plus their neighbours.
+// A map that isn't on fire costs nothing per step.
+class FireGrid {
+public:
+    static const int BLOCK_SIZE = 8;
+    static const int BLOCK_SHIFT = 3;
+
+    FireGrid(const glm::ivec3& resolution, GLfloat cellSize, const glm::vec3& origin);
+
+    // Places fuel in seconds of burning, cells outside the grid are ignored
+    void SetFuel(const glm::ivec3& cell, GLfloat fuel);
+    // Sets the fuel cell at a world-space position on fire
+    void Ignite(const glm::vec3& position);
+    // Spreads heat and burns fuel along the active frontier
+    void Step(GLfloat dt);
+
+    // Blocks that caught fire or went out during the last Step
+    const std::vector<GLuint>& GetIgnitedBlocks() const { return m_ignited; }
+    const std::vector<GLuint>& GetExtinguishedBlocks() const { return m_extinguished; }
+
+    // World-space center of the cells burning in a block
+    glm::vec3 GetFireCenter(GLuint block) const;
+    GLuint GetBurningCells(GLuint block) const { return m_blocks[block].nBurning; }
+    // Blocks visited by the next Step
+    size_t GetActiveBlockCount() const { return m_active.size(); }
+    GLfloat GetBlockExtent() const { return BLOCK_SIZE * m_cellSize; }
+
+private:
+    enum class CellState : GLubyte { empty, fuel, burning, burnt };
+
+    static const int BLOCK_CELLS = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+
+    struct Block {
+        glm::ivec3 coord;
+        GLfloat fuel[BLOCK_CELLS];
+        GLfloat temperature[BLOCK_CELLS];
+        // written by Step, swapped with temperature afterwards
+        GLfloat temperature0[BLOCK_CELLS];
+        CellState state[BLOCK_CELLS];
+
+        // results of the last Step and the one before
+        GLuint nBurning;
+        GLuint nBurningBefore;
+        glm::vec3 burningSum;
+        GLfloat maxTemperature;
+
+        bool active;
+        // step in which the block was last added to the frontier
+        uint64_t visited;
+    };
+
+    // floor division, also for the -1 cells around the grid
+    static glm::ivec3 BlockOf(const glm::ivec3& cell)
+    {
+        return glm::ivec3(cell.x >> BLOCK_SHIFT, cell.y >> BLOCK_SHIFT, cell.z >> BLOCK_SHIFT);
+    }
+    static int CellIndex(const glm::ivec3& local)
+    {
+        return (local.z * BLOCK_SIZE + local.y) * BLOCK_SIZE + local.x;
+    }
+    // Index into m_blocks, -1 if not allocated or outside the grid
+    int32_t FindBlock(const glm::ivec3& coord) const;
+    GLuint AllocateBlock(const glm::ivec3& coord);
+    void Activate(GLuint block);
+    // Temperature of a cell anywhere in the grid, ambient where unallocated
+    GLfloat Temperature(const glm::ivec3& cell) const;
+    void StepBlock(Block& block, GLfloat dt) const;
+
+    const glm::ivec3 m_resolution;
+    const GLfloat m_cellSize;
+    const glm::vec3 m_origin;
+    const glm::ivec3 m_blockResolution;
+
+    // per block coordinate: index into m_blocks or -1
+    std::vector<int32_t> m_blockTable;
+    // never shrinks, indices stay valid for the lifetime of the grid
+    std::vector<Block> m_blocks;
+
+    std::vector<GLuint> m_active;
+    std::vector<GLuint> m_frontier;
+    std::vector<GLuint> m_ignited;
+    std::vector<GLuint> m_extinguished;
+    uint64_t m_step;
+};
@@ -0,0 +1,196 @@
+#include "fluid_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.h"
+
+#define AMBIENT_TEMPERATURE 0.0f
+#define BUOYANCY 1.5f
+#define COOLING_RATE 1.2f
+#define VELOCITY_DAMPING 0.3f
+#define JACOBI_ITERATIONS 20
+
+FluidGrid::FluidGrid(const glm::ivec3& resolution, GLfloat cellSize,
+                     const glm::vec3& origin)
+    : m_resolution(resolution),
+      m_cellSize(cellSize),
+      m_origin(origin)
+{
+    const size_t nCells = static_cast<size_t>(resolution.x) * resolution.y * resolution.z;
+    for (auto* field : {&m_u, &m_v, &m_w, &m_temperature,
+                        &m_u0, &m_v0, &m_w0, &m_temperature0,
+                        &m_heat, &m_pressure, &m_pressure0, &m_divergence}) {
+        field->assign(nCells, 0.0f);
+    }
+}
+
+void FluidGrid::AddHeat(const glm::vec3& position, GLfloat radius, GLfloat amount)
+{
+    const glm::vec3 center = (position - m_origin) / m_cellSize - 0.5f;
+    const GLfloat cellRadius = radius / m_cellSize;
+
+    const int x0 = std::max(static_cast<int>(center.x - cellRadius), 0);
+    const int y0 = std::max(static_cast<int>(center.y - cellRadius), 0);
+    const int z0 = std::max(static_cast<int>(center.z - cellRadius), 0);
+    const int x1 = std::min(static_cast<int>(center.x + cellRadius), m_resolution.x - 1);
+    const int y1 = std::min(static_cast<int>(center.y + cellRadius), m_resolution.y - 1);
+    const int z1 = std::min(static_cast<int>(center.z + cellRadius), m_resolution.z - 1);
+
+    for (int z = z0; z <= z1; ++z) {
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                const GLfloat distance = glm::length(glm::vec3(x, y, z) - center);
+                if (distance < cellRadius) {
+                    // linear falloff towards the edge of the source
+                    m_heat[Index(x, y, z)] += amount * (1.0f - distance / cellRadius);
+                }
+            }
+        }
+    }
+}
+
+void FluidGrid::Step(GLfloat dt)
+{
+    ApplySources(dt);
+    Advect(dt);
+    Project();
+}
+
+glm::vec3 FluidGrid::SampleVelocity(const glm::vec3& position) const
+{
+    const glm::vec3 g = (position - m_origin) / m_cellSize - 0.5f;
+    if (g.x < 0.0f || g.y < 0.0f || g.z < 0.0f ||
+        g.x > m_resolution.x - 1 || g.y > m_resolution.y - 1 || g.z > m_resolution.z - 1) {
+        return glm::vec3(0.0f);
+    }
+    return glm::vec3(Sample(m_u, g), Sample(m_v, g), Sample(m_w, g));
+}
+
+GLfloat FluidGrid::Sample(const std::vector<GLfloat>& field, const glm::vec3& g) const
+{
+    const glm::vec3 c = glm::clamp(g, glm::vec3(0.0f), glm::vec3(m_resolution - 1));
+    const int x0 = std::min(static_cast<int>(c.x), m_resolution.x - 2);
+    const int y0 = std::min(static_cast<int>(c.y), m_resolution.y - 2);
+    const int z0 = std::min(static_cast<int>(c.z), m_resolution.z - 2);
+    const GLfloat tx = c.x - x0;
+    const GLfloat ty = c.y - y0;
+    const GLfloat tz = c.z - z0;
+
+    const size_t i = Index(x0, y0, z0);
+    const size_t dy = m_resolution.x;
+    const size_t dz = static_cast<size_t>(m_resolution.x) * m_resolution.y;
+
+    const GLfloat c00 = glm::mix(field[i], field[i + 1], tx);
+    const GLfloat c10 = glm::mix(field[i + dy], field[i + dy + 1], tx);
+    const GLfloat c01 = glm::mix(field[i + dz], field[i + dz + 1], tx);
+    const GLfloat c11 = glm::mix(field[i + dz + dy], field[i + dz + dy + 1], tx);
+    return glm::mix(glm::mix(c00, c10, ty), glm::mix(c01, c11, ty), tz);
+}
+
+void FluidGrid::ApplySources(GLfloat dt)
+{
+    const GLfloat cooling = std::exp(-COOLING_RATE * dt);
+    const GLfloat damping = std::exp(-VELOCITY_DAMPING * dt);
+    const size_t slice = static_cast<size_t>(m_resolution.x) * m_resolution.y;
+
+    ThreadPool::Instance().ParallelFor(0, m_resolution.z, [&](size_t zBegin, size_t zEnd) {
+        for (size_t i = zBegin * slice; i < zEnd * slice; ++i) {
+            const GLfloat temperature = (m_temperature[i] + m_heat[i]) * cooling;
+            m_temperature[i] = temperature;
+            m_heat[i] = 0.0f;
+            // hot cells rise
+            m_v[i] = (m_v[i] + dt * BUOYANCY * (temperature - AMBIENT_TEMPERATURE)) * damping;
+            m_u[i] *= damping;
+            m_w[i] *= damping;
+        }
+    });
+}
+
+void FluidGrid::Advect(GLfloat dt)
+{
+    m_u0.swap(m_u);
+    m_v0.swap(m_v);
+    m_w0.swap(m_w);
+    m_temperature0.swap(m_temperature);
+
+    const GLfloat scale = dt / m_cellSize;
+    ThreadPool::Instance().ParallelFor(0, m_resolution.z, [&](size_t zBegin, size_t zEnd) {
+        for (int z = zBegin; z < static_cast<int>(zEnd); ++z) {
+            for (int y = 0; y < m_resolution.y; ++y) {
+                for (int x = 0; x < m_resolution.x; ++x) {
+                    const size_t i = Index(x, y, z);
+                    // trace the cell center back along the velocity
+                    const glm::vec3 from(x - scale * m_u0[i],
+                                         y - scale * m_v0[i],
+                                         z - scale * m_w0[i]);
+                    m_u[i] = Sample(m_u0, from);
+                    m_v[i] = Sample(m_v0, from);
+                    m_w[i] = Sample(m_w0, from);
+                    m_temperature[i] = Sample(m_temperature0, from);
+                }
+            }
+        }
+    });
+}
+
+void FluidGrid::Project()
+{
+    const int nx = m_resolution.x;
+    const int ny = m_resolution.y;
+    const int nz = m_resolution.z;
+    const size_t dy = nx;
+    const size_t dz = static_cast<size_t>(nx) * ny;
+    const GLfloat halfInvH = 0.5f / m_cellSize;
+    const GLfloat h2 = m_cellSize * m_cellSize;
+    ThreadPool& pool = ThreadPool::Instance();
+
+    // Interior cells only, the boundary keeps zero pressure (open domain)
+    pool.ParallelFor(1, nz - 1, [&](size_t zBegin, size_t zEnd) {
+        for (size_t z = zBegin; z < zEnd; ++z) {
+            for (int y = 1; y < ny - 1; ++y) {
+                const size_t row = Index(0, y, z);
+                for (int x = 1; x < nx - 1; ++x) {
+                    const size_t i = row + x;
+                    m_divergence[i] = halfInvH * ((m_u[i + 1] - m_u[i - 1]) +
+                                                  (m_v[i + dy] - m_v[i - dy]) +
+                                                  (m_w[i + dz] - m_w[i - dz]));
+                    m_pressure[i] = 0.0f;
+                }
+            }
+        }
+    });
+
+    for (int iteration = 0; iteration < JACOBI_ITERATIONS; ++iteration) {
+        m_pressure0.swap(m_pressure);
+        pool.ParallelFor(1, nz - 1, [&](size_t zBegin, size_t zEnd) {
+            for (size_t z = zBegin; z < zEnd; ++z) {
+                for (int y = 1; y < ny - 1; ++y) {
+                    const size_t row = Index(0, y, z);
+                    for (int x = 1; x < nx - 1; ++x) {
+                        const size_t i = row + x;
+                        m_pressure[i] = (m_pressure0[i - 1] + m_pressure0[i + 1] +
+                                         m_pressure0[i - dy] + m_pressure0[i + dy] +
+                                         m_pressure0[i - dz] + m_pressure0[i + dz] -
+                                         h2 * m_divergence[i]) * (1.0f / 6.0f);
+                    }
+                }
+            }
+        });
+    }
+
+    // Subtract the pressure gradient to make the field divergence free
+    pool.ParallelFor(1, nz - 1, [&](size_t zBegin, size_t zEnd) {
+        for (size_t z = zBegin; z < zEnd; ++z) {
+            for (int y = 1; y < ny - 1; ++y) {
+                const size_t row = Index(0, y, z);
+                for (int x = 1; x < nx - 1; ++x) {
+                    const size_t i = row + x;
+                    m_u[i] -= halfInvH * (m_pressure[i + 1] - m_pressure[i - 1]);
+                    m_v[i] -= halfInvH * (m_pressure[i + dy] - m_pressure[i - dy]);
+                    m_w[i] -= halfInvH * (m_pressure[i + dz] - m_pressure[i - dz]);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Coarse 3D stable-fluids solver (semi-Lagrangian advection, buoyancy
+// from heat, Jacobi pressure projection) on a collocated grid.
+// Fields are stored as separate x-major float arrays so that the inner
+// loops run over contiguous memory, and each pass is split in z-slabs
+// across the thread pool. Particles only sample the velocity field, so
+// the solver cost depends on the resolution, not on the particle count.
+class FluidGrid {
+public:
+    FluidGrid(const glm::ivec3& resolution, GLfloat cellSize,
+              const glm::vec3& origin);
+
+    // Adds heat around a world-space position, applied on the next Step()
+    void AddHeat(const glm::vec3& position, GLfloat radius, GLfloat amount);
+    // Advances the simulation by dt
+    void Step(GLfloat dt);
+    // Trilinearly interpolated velocity at a world-space position,
+    // zero outside of the grid
+    glm::vec3 SampleVelocity(const glm::vec3& position) const;
+
+    const glm::ivec3& GetResolution() const { return m_resolution; }
+    GLfloat GetCellSize() const { return m_cellSize; }
+    const glm::vec3& GetOrigin() const { return m_origin; }
+
+private:
+    size_t Index(int x, int y, int z) const
+    {
+        return (static_cast<size_t>(z) * m_resolution.y + y) * m_resolution.x + x;
+    }
+    // Trilinear lookup in grid coordinates (cell centers at integers)
+    GLfloat Sample(const std::vector<GLfloat>& field, const glm::vec3& g) const;
+
+    void ApplySources(GLfloat dt);
+    void Advect(GLfloat dt);
+    void Project();
+
+    const glm::ivec3 m_resolution;
+    const GLfloat m_cellSize;
+    const glm::vec3 m_origin;
+
+    // velocity, temperature and their previous step copies
+    std::vector<GLfloat> m_u, m_v, m_w, m_temperature;
+    std::vector<GLfloat> m_u0, m_v0, m_w0, m_temperature0;
+    std::vector<GLfloat> m_heat;
+    std::vector<GLfloat> m_pressure, m_pressure0, m_divergence;
+};
@@ -0,0 +1,28 @@
+#include "frame_uniforms.h"
+
+#include <cstring>
+
+FrameUniforms::FrameUniforms()
+    : m_UBO(0),
+      m_data(),
+      m_valid(false)
+{
+}
+
+void FrameUniforms::Init()
+{
+    glCreateBuffers(1, &m_UBO);
+    glNamedBufferStorage(m_UBO, sizeof(FrameData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, m_UBO);
+    m_valid = false;
+}
+
+void FrameUniforms::Update(const FrameData& data)
+{
+    if (m_valid && std::memcmp(&m_data, &data, sizeof(FrameData)) == 0) {
+        return;
+    }
+    m_data = data;
+    m_valid = true;
+    glNamedBufferSubData(m_UBO, 0, sizeof(FrameData), &m_data);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Binding point of the "Frame" uniform block, must match the
+// layout(binding = ...) qualifier in the shaders
+static const GLuint FRAME_UNIFORM_BINDING = 0;
+
+// CPU mirror of the std140 "Frame" block, members are kept 16-byte
+// aligned so the struct can be copied verbatim
+struct FrameData {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 cameraPosition;
+};
+
+// Uniform buffer holding the camera and frame constants shared by all
+// programs. Uploaded at most once per frame and only when it changed.
+class FrameUniforms {
+public:
+    // No GL calls here, Game is constructed before the context exists.
+    // The buffer is released together with the context
+    FrameUniforms();
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    // Creates the buffer and binds it to FRAME_UNIFORM_BINDING
+    void Init();
+    void Update(const FrameData& data);
+
+private:
+    GLuint m_UBO;
+    FrameData m_data;
+    bool m_valid;
+};
@@ -9,13 +9,49 @@
 #include "game.h"
 #include "resource_manager.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <tuple>
 
 // TODO: replace this hack
 #define ENERGY 500.0f
-#define RADIUS 3.0f
 #define N_PARTICLES 5000 * 1.0
 #define N_BURST_RATE 300 * 1.0
+// shared memory frames, see Game::Publish
+#define SHARED_MAX_PARTICLES (1 << 19)
+#define SHARED_MAX_EMITTERS 1024
+#define SHARED_SLOTS 4
+// density export, cells per fluid cell and axis, see Game::ExportDensity
+#define DENSITY_SUBDIVISION 4
+
+// spawned per frame for every burning cell of an emitter's block
+#define PARTICLES_PER_BURNING_CELL 4
+// EmitterMode::stateless moves the particle animation to the GPU
+#define PARTICLE_MODE EmitterMode::simulated
+
+// embers left by dying flame particles, one per EMBER_EVERY deaths
+#define N_EMBERS 20000
+#define EMBER_EVERY 16
+
+// scripted fires, see ParticleCommandQueue
+#define SCRIPTED_FIRE_RADIUS 1.0f
+#define COMMANDS_PER_FRAME 1024
+
+#define FLUID_RESOLUTION glm::ivec3(32, 64, 32)
+#define FLUID_CELL_SIZE 0.5f
+
+#define TURBULENCE_AMPLITUDE 1.5f
+#define TURBULENCE_FREQUENCY 0.15f
+
+// burnable scene, same footprint as the fluid volume
+#define FIRE_RESOLUTION glm::ivec3(32, 16, 32)
+#define FIRE_CELL_SIZE 0.5f
+#define GROUND_FUEL 4.0f
+#define GROUND_GAPS 0.2f
+#define N_TREES 12
+#define TREE_FUEL 8.0f
 
 // FPSMeter {{{
 FPSMeter::FPSMeter()
@@ -38,13 +74,19 @@ void FPSMeter::Count(GLfloat dt)
 
 Game::Game(GLuint width, GLuint height)
     : m_state(GameState::active),
+      m_printTimings(GL_FALSE),
+      m_toggleOverdraw(GL_FALSE),
       m_mouseXOffset(0.0f),
       m_mouseYOffset(0.0f),
       m_width(width),
       m_height(height),
       m_camera(glm::vec3(0.0f, 0.0f, 3.0f),
                glm::vec3(0.0f, 1.0f, 0.0f),
-               -10.0f)
+               -10.0f),
+      m_frustum(glm::mat4(1.0f)),
+      m_pixelsPerUnit(0.0f),
+      m_nSimulatedFrames(0),
+      m_nIgnitions(0)
 {
 }
 
@@ -66,35 +108,427 @@ void Game::SetMouseScroll(GLfloat xoffset, GLfloat yoffset)
 
 void Game::Init()
 {
+    // Start decoding textures first so it overlaps shader compilation
+    ResourceManager::LoadTextureArrayAsync(
+        {"textures/fire.png", "textures/fire_2.png", "textures/fire_3.png"},
+        GL_TRUE, "fire");
+
     // Load shaders
     ResourceManager::LoadShader("shaders/particle.vs", "shaders/particle.fs", nullptr, "particle");
+    ResourceManager::GetShader("particle").Use().SetInteger("sprite", 0);
+    ResourceManager::LoadShader("shaders/particle_stateless.vs", "shaders/particle.fs", nullptr, "particle_stateless");
+    ResourceManager::GetShader("particle_stateless").Use().SetInteger("sprite", 0);
+    ResourceManager::LoadShader("shaders/composite.vs", "shaders/composite.fs", nullptr, "composite");
+    m_particleTarget.Init(ResourceManager::GetShader("composite"));
+    ResourceManager::LoadShader("shaders/composite.vs", "shaders/heatmap.fs", nullptr, "heatmap");
+    m_overdrawMeter.Init(ResourceManager::GetShader("heatmap"),
+                         {ResourceManager::GetShader("particle"),
+                          ResourceManager::GetShader("particle_stateless")});
+    // baked once, emitters only sample it
+    m_ptrNoise.reset(new CurlNoise());
+    m_frameUniforms.Init();
+
+    // fluid volume around the fire, 16x32x16 units with the ignition
+    // point at the bottom center
+    const glm::vec3 firePosition(20, 0, 0);
+    const glm::vec3 fluidSize = glm::vec3(FLUID_RESOLUTION) * FLUID_CELL_SIZE;
+    const glm::vec3 fluidOrigin = firePosition - glm::vec3(fluidSize.x / 2, 2.0f, fluidSize.z / 2);
+    m_ptrFluid.reset(new FluidGrid(FLUID_RESOLUTION, FLUID_CELL_SIZE, fluidOrigin));
+
+    InitFire(firePosition);
+}
+
+bool Game::Publish(const std::string& name)
+{
+    m_ptrPublisher.reset(new SharedFramePublisher());
+    if (!m_ptrPublisher->Open(name, SHARED_MAX_PARTICLES, SHARED_MAX_EMITTERS, SHARED_SLOTS)) {
+        m_ptrPublisher.reset();
+        return false;
+    }
+    return true;
+}
+
+bool Game::View(const std::string& name)
+{
+    m_ptrViewer.reset(new SharedFrameViewer(ResourceManager::GetShader("particle"),
+                                            ResourceManager::GetTextureArray("fire")));
+    if (!m_ptrViewer->Open(name)) {
+        m_ptrViewer.reset();
+        return false;
+    }
+    return true;
+}
+
+bool Game::ExportDensity(const std::string& path)
+{
+    m_ptrDensity.reset(new DensityGrid(m_ptrFluid->GetResolution() * DENSITY_SUBDIVISION,
+                                       m_ptrFluid->GetCellSize() / DENSITY_SUBDIVISION,
+                                       m_ptrFluid->GetOrigin()));
+    m_ptrDensityWriter.reset(new DensityWriter());
+    if (!m_ptrDensityWriter->Open(path, *m_ptrDensity)) {
+        m_ptrDensity.reset();
+        m_ptrDensityWriter.reset();
+        return false;
+    }
+    return true;
+}
 
-    // Load textures
-    ResourceManager::GetShader("particle").Use().SetInteger("particle", 0);
-    ResourceManager::LoadTexture("textures/fire_2.png", GL_FALSE, "particle");
+void Game::InitFire(const glm::vec3& center)
+{
+    const glm::vec3 fireSize = glm::vec3(FIRE_RESOLUTION) * FIRE_CELL_SIZE;
+    const glm::vec3 origin = center - glm::vec3(fireSize.x / 2, 2.0f, fireSize.z / 2);
+    m_ptrFire.reset(new FireGrid(FIRE_RESOLUTION, FIRE_CELL_SIZE, origin));
+
+    // Patchy ground cover at the ignition height plus a few trees
+    const int ground = static_cast<int>(2.0f / FIRE_CELL_SIZE);
+    std::uniform_real_distribution<GLfloat> chance(0.0f, 1.0f);
+    for (int z = 0; z < FIRE_RESOLUTION.z; ++z) {
+        for (int x = 0; x < FIRE_RESOLUTION.x; ++x) {
+            if (chance(m_rndGenerator) > GROUND_GAPS) {
+                m_ptrFire->SetFuel(glm::ivec3(x, ground, z), GROUND_FUEL);
+            }
+        }
+    }
+    std::uniform_int_distribution<int> column(0, FIRE_RESOLUTION.x - 1);
+    std::uniform_int_distribution<int> height(4, FIRE_RESOLUTION.y - ground - 1);
+    for (int tree = 0; tree < N_TREES; ++tree) {
+        const int x = column(m_rndGenerator);
+        const int z = column(m_rndGenerator);
+        for (int y = 1, top = height(m_rndGenerator); y <= top; ++y) {
+            m_ptrFire->SetFuel(glm::ivec3(x, ground + y, z), TREE_FUEL);
+        }
+    }
+    // no gap under the ignition point
+    m_ptrFire->SetFuel(glm::ivec3(FIRE_RESOLUTION.x / 2, ground, FIRE_RESOLUTION.z / 2), GROUND_FUEL);
+    m_ptrFire->Ignite(center + glm::vec3(0.0f, 0.5f * FIRE_CELL_SIZE, 0.0f));
+}
+
+void Game::UpdateFires(GLfloat dt)
+{
+    m_ptrFire->Step(dt);
+
+    for (GLuint block : m_ptrFire->GetIgnitedBlocks()) {
+        auto previous = m_fires.find(block);
+        if (previous != m_fires.end()) {
+            m_emitters.Extinguish(previous->second);
+        }
+        const EmitterHandle handle = m_emitters.Create(
+            ResourceManager::GetShader(PARTICLE_MODE == EmitterMode::stateless ? "particle_stateless"
+                                                                                : "particle"),
+            ResourceManager::GetTextureArray("fire"),
+            m_ptrFire->GetFireCenter(block),
+            glm::vec3(0.0f, 1.0f, 0.0f),
+            0.5f * m_ptrFire->GetBlockExtent(),
+            ENERGY,
+            7,
+            N_PARTICLES,
+            PARTICLE_MODE);
+        Emitter* emitter = m_emitters.Get(handle);
+        emitter->SetTurbulence(m_ptrNoise.get(), TURBULENCE_AMPLITUDE, TURBULENCE_FREQUENCY);
+        // a block burning twice gets a fresh stream
+        emitter->SetSeed((static_cast<uint64_t>(m_nIgnitions++) << 32) | block);
+        m_fires[block] = handle;
 
-    m_ptrParticles.reset(
-        new Emitter(ResourceManager::GetShader("particle"),
-                    ResourceManager::GetTexture("particle"),
-                    glm::vec3(20, 0, 0),
-                    glm::vec3(0.0f, 1.0f, 0.0f),
-                    RADIUS,
-                    ENERGY,
-                    7,
-                    N_PARTICLES));
+        if (!m_emitters.Get(m_embers)) {
+            // spawns at the flames only, placed at the fire for culling
+            m_embers = m_emitters.Create(
+                ResourceManager::GetShader(PARTICLE_MODE == EmitterMode::stateless ? "particle_stateless"
+                                                                                    : "particle"),
+                ResourceManager::GetTextureArray("fire"),
+                m_ptrFire->GetFireCenter(block),
+                glm::vec3(0.0f, 1.0f, 0.0f),
+                0.1f,
+                ENERGY,
+                1,
+                N_EMBERS,
+                PARTICLE_MODE,
+                EmitterEffect::embers);
+            Emitter* embers = m_emitters.Get(m_embers);
+            embers->SetTurbulence(m_ptrNoise.get(), TURBULENCE_AMPLITUDE, TURBULENCE_FREQUENCY);
+            embers->SetSeed(static_cast<uint64_t>(m_nIgnitions++) << 32);
+        }
+        m_emitters.SetSubEmitter(handle, m_embers, ParticleEvent::Type::death, 1, EMBER_EVERY);
+    }
+    for (GLuint block : m_ptrFire->GetExtinguishedBlocks()) {
+        auto fire = m_fires.find(block);
+        if (fire != m_fires.end()) {
+            // burns out in the manager
+            m_emitters.Extinguish(fire->second);
+            m_fires.erase(fire);
+        }
+    }
+
+    for (auto fire = m_fires.begin(); fire != m_fires.end();) {
+        // out of energy and retired while its block still burns
+        const Emitter* emitter = m_emitters.Get(fire->second);
+        if (!emitter) {
+            fire = m_fires.erase(fire);
+            continue;
+        }
+        const GLuint nBurning = m_ptrFire->GetBurningCells(fire->first);
+        const GLuint nNewParticles = std::min<GLuint>(nBurning * PARTICLES_PER_BURNING_CELL, N_BURST_RATE);
+        // follows the flames as they move through the block
+        const glm::vec3 offset = m_ptrFire->GetFireCenter(fire->first) - emitter->GetPosition();
+        m_emitters.SetEmission(fire->second, nNewParticles, offset);
+        ++fire;
+    }
 }
 
-void Game::Update(GLfloat dt)
+void Game::ApplyCommand(const ParticleCommand& command)
+{
+    auto fire = m_scriptedFires.find(command.fire);
+    switch (command.type) {
+    case ParticleCommand::Type::ignite: {
+        if (fire != m_scriptedFires.end()) {
+            m_emitters.Extinguish(fire->second.handle);
+        }
+        const EmitterHandle handle = m_emitters.Create(
+            ResourceManager::GetShader(PARTICLE_MODE == EmitterMode::stateless ? "particle_stateless"
+                                                                                : "particle"),
+            ResourceManager::GetTextureArray("fire"),
+            command.position,
+            glm::vec3(0.0f, 1.0f, 0.0f),
+            SCRIPTED_FIRE_RADIUS,
+            ENERGY,
+            7,
+            N_PARTICLES,
+            PARTICLE_MODE);
+        Emitter* emitter = m_emitters.Get(handle);
+        emitter->SetTurbulence(m_ptrNoise.get(), TURBULENCE_AMPLITUDE, TURBULENCE_FREQUENCY);
+        emitter->SetSeed((static_cast<uint64_t>(m_nIgnitions++) << 32) | command.fire);
+        m_emitters.SetEmission(handle, command.count);
+        m_scriptedFires[command.fire] = {handle, command.count};
+        // and whatever burns there catches fire as well
+        m_ptrFire->Ignite(command.position);
+        break;
+    }
+    case ParticleCommand::Type::burst:
+        if (fire != m_scriptedFires.end()) {
+            m_emitters.Burst(fire->second.handle, command.count);
+        }
+        break;
+    case ParticleCommand::Type::move:
+        if (fire != m_scriptedFires.end()) {
+            if (const Emitter* emitter = m_emitters.Get(fire->second.handle)) {
+                m_emitters.SetEmission(fire->second.handle, fire->second.particlesPerFrame,
+                                       command.position - emitter->GetPosition());
+            }
+        }
+        break;
+    case ParticleCommand::Type::extinguish:
+        if (fire != m_scriptedFires.end()) {
+            // burns out in the manager
+            m_emitters.Extinguish(fire->second.handle);
+            m_scriptedFires.erase(fire);
+        }
+        break;
+    }
+}
+
+void Game::Frame(GLfloat dt)
 {
-    static int nCnt = 0;
     m_fpsMeter.Count(dt);
-    // Update particles
-    if (m_ptrParticles && nCnt < 2000) {
-        const size_t nDeviation = N_BURST_RATE * 0.2f;
-        std::uniform_int_distribution<> distribution(N_BURST_RATE - nDeviation,
-                                                     N_BURST_RATE + nDeviation);
-        m_ptrParticles->Update(dt, distribution(m_rndGenerator));
-        ++nCnt;
+    m_frame.Clear();
+    // viewers only draw what the publisher simulated
+    const bool simulate = m_ptrFire && !m_ptrViewer && m_nSimulatedFrames < 2000;
+    const bool render = m_state == GameState::active;
+
+    // 1. Per frame: resources and camera
+    const auto resources = m_frame.Add("resources", [this]() {
+        // Swap placeholders for textures decoded since the last frame
+        ResourceManager::UploadPendingTextures();
+        m_ptrNoise->Poll();
+    }, true);
+    const auto input = m_frame.Add("input", [this, dt]() { ProcessInput(dt); });
+    const auto camera = m_frame.Add("camera", [this]() { UpdateCamera(); }, true);
+    m_frame.Precede(input, camera);
+    // the particle pass draws into the reduced resolution target between
+    // these two, composite adds it onto the screen. In overdraw mode the
+    // meter takes the place of the target
+    TaskGraph::TaskId particles = 0;
+    TaskGraph::TaskId composite = 0;
+    if (render) {
+        particles = m_frame.Add("particles", [this]() {
+            if (m_toggleOverdraw) {
+                m_overdrawMeter.SetEnabled(!m_overdrawMeter.IsEnabled());
+                m_toggleOverdraw = GL_FALSE;
+            }
+            if (m_overdrawMeter.IsEnabled()) {
+                m_overdrawMeter.Begin(m_width, m_height, m_particleTarget.GetDivisor());
+            } else {
+                m_particleTarget.Begin(m_width, m_height);
+            }
+        }, true);
+        composite = m_frame.Add("composite", [this]() {
+            if (m_overdrawMeter.IsEnabled()) {
+                m_overdrawMeter.End();
+            } else {
+                m_particleTarget.End();
+            }
+        }, true);
+        m_frame.Precede(camera, particles);
+        m_frame.Precede(particles, composite);
+        if (m_ptrViewer) {
+            const auto view = m_frame.Add("view", [this]() { m_ptrViewer->Draw(); }, true);
+            m_frame.Precede(particles, view);
+            m_frame.Precede(view, composite);
+        }
+    }
+
+    // 2. Fluid and fire, new emitters are drawn from the next frame on
+    TaskGraph::TaskId fluid = 0;
+    TaskGraph::TaskId fires = 0;
+    TaskGraph::TaskId lod = 0;
+    if (simulate) {
+        ++m_nSimulatedFrames;
+        fluid = m_frame.Add("fluid", [this, dt]() { m_ptrFluid->Step(dt); });
+        // commands of other threads, new fires join the next frame
+        const auto commands = m_frame.Add("commands", [this]() {
+            m_commands.Drain(COMMANDS_PER_FRAME, [this](const ParticleCommand& command) {
+                ApplyCommand(command);
+            });
+        }, true);
+        fires = m_frame.Add("fires", [this, dt]() { UpdateFires(dt); }, true);
+        m_frame.Precede(commands, fires);
+        // emitters pick up the curl noise Poll swapped in
+        m_frame.Precede(resources, fires);
+        // fires small on screen update a part of their particles per frame
+        lod = m_frame.Add("lod", [this]() {
+            m_emitters.UpdateLod(m_camera.GetPosition(), m_pixelsPerUnit);
+        });
+        m_frame.Precede(camera, lod);
+        m_frame.Precede(fires, lod);
+    }
+
+    // 3. Per emitter: simulate, cull, map, fill and submit, every chain
+    // moves on as soon as its emitter is done
+    std::vector<EmitterHandle> handles;
+    m_emitters.GetHandles(handles);
+    const auto retire = m_frame.Add("retire", [this]() { m_emitters.Retire(); }, true);
+    TaskGraph::TaskId heat = 0;
+    if (simulate) {
+        // serial, so the heat sums don't depend on the thread count
+        heat = m_frame.Add("heat", [this, dt]() { m_emitters.AddHeat(dt, *m_ptrFluid); });
+        m_frame.Precede(fluid, heat);
+        m_frame.Precede(fires, heat);
+        m_frame.Precede(heat, retire);
+    }
+    // after every emitter update, beside the draw stages which only read
+    // the particles as well
+    TaskGraph::TaskId publish = 0;
+    if (m_ptrPublisher && simulate) {
+        publish = m_frame.Add("publish", [this]() { m_ptrPublisher->Publish(m_emitters); });
+        m_frame.Precede(fires, publish);
+        m_frame.Precede(publish, retire);
+    }
+    // the same for the density export
+    TaskGraph::TaskId density = 0;
+    if (m_ptrDensity && simulate) {
+        density = m_frame.Add("density", [this, dt]() {
+            m_ptrDensity->Splat(m_emitters);
+            m_ptrDensityWriter->Write(*m_ptrDensity, dt);
+        });
+        m_frame.Precede(fires, density);
+        m_frame.Precede(density, retire);
+    }
+    // sub-emitters spawn once all emitters updated, so the draw stages
+    // wait for it
+    TaskGraph::TaskId subemit = 0;
+    if (simulate && m_emitters.HasSubEmitters()) {
+        subemit = m_frame.Add("subemit", [this]() { m_emitters.SpawnSubEmitters(); });
+        if (publish) {
+            m_frame.Precede(subemit, publish);
+        }
+        if (density) {
+            m_frame.Precede(subemit, density);
+        }
+    }
+    for (const EmitterHandle handle : handles) {
+        Emitter* emitter = m_emitters.Get(handle);
+        auto last = camera;
+        if (simulate) {
+            const auto update = m_frame.Add("simulate", [this, handle, dt]() {
+                m_emitters.UpdateEmitter(handle, dt, *m_ptrFluid);
+            });
+            m_frame.Precede(fluid, update);
+            m_frame.Precede(fires, update);
+            m_frame.Precede(lod, update);
+            m_frame.Precede(update, heat);
+            if (publish) {
+                m_frame.Precede(update, publish);
+            }
+            if (density) {
+                m_frame.Precede(update, density);
+            }
+            last = update;
+            if (subemit) {
+                m_frame.Precede(update, subemit);
+                last = subemit;
+            }
+        }
+        if (render) {
+            const auto cull = m_frame.Add("cull", [this, emitter]() {
+                emitter->Cull(m_frustum);
+            });
+            const auto map = m_frame.Add("map", [emitter]() { emitter->Map(); }, true);
+            const auto fill = m_frame.Add("fill", [emitter]() { emitter->Fill(); });
+            const auto submit = m_frame.Add("submit", [emitter]() { emitter->Submit(); }, true);
+            m_frame.Precede(camera, cull);
+            m_frame.Precede(last, cull);
+            m_frame.Precede(cull, map);
+            m_frame.Precede(map, fill);
+            m_frame.Precede(fill, submit);
+            m_frame.Precede(particles, submit);
+            m_frame.Precede(submit, composite);
+            last = submit;
+        }
+        m_frame.Precede(last, retire);
+    }
+
+    m_frame.Run();
+    m_overdrawMeter.Count(dt);
+
+    if (m_printTimings) {
+        PrintFrameTimings();
+        const ParticleCommandStats stats = m_commands.GetStats();
+        std::cout << "Commands: " << stats.nApplied << " applied, " << stats.nOverflows
+                  << " dropped, " << stats.meanLatencyMs << " ms mean wait, " << stats.maxLatencyMs
+                  << " ms longest" << std::endl;
+        m_commands.ResetStats();
+        m_printTimings = GL_FALSE;
+    }
+}
+
+void Game::UpdateCamera()
+{
+    // Update projection and view matrices
+    const glm::mat4 projection = glm::perspective(
+        m_camera.GetZoom(),
+        static_cast<GLfloat>(m_width) / static_cast<GLfloat>(m_height), 0.1f,
+        100.0f);
+    const glm::mat4 view = m_camera.GetViewMatrix();
+    m_frustum = Frustum(projection * view);
+    m_pixelsPerUnit = std::abs(projection[1][1]) * m_height * 0.5f;
+    m_frameUniforms.Update({projection, view, glm::vec4(m_camera.GetPosition(), 1.0f)});
+}
+
+void Game::PrintFrameTimings() const
+{
+    // name -> count, total and longest
+    std::map<std::string, std::tuple<size_t, double, double>> tasks;
+    double frameMs = 0.0;
+    for (const TaskTiming& timing : m_frame.GetTimings()) {
+        auto& task = tasks[timing.name];
+        ++std::get<0>(task);
+        std::get<1>(task) += timing.durationMs;
+        std::get<2>(task) = std::max(std::get<2>(task), timing.durationMs);
+        frameMs = std::max(frameMs, timing.startMs + timing.durationMs);
+    }
+    std::cout << "Frame: " << frameMs << " ms" << std::endl;
+    for (const auto& task : tasks) {
+        std::cout << "  " << task.first << ": " << std::get<0>(task.second) << " tasks, "
+                  << std::get<1>(task.second) << " ms total, " << std::get<2>(task.second)
+                  << " ms longest" << std::endl;
     }
 }
 
@@ -115,6 +549,32 @@ void Game::ProcessInput(GLfloat dt)
         }
     }
 
+    if (m_keys[GLFW_KEY_T] && !m_keysProcessed[GLFW_KEY_T]) {
+        m_printTimings = GL_TRUE;
+        m_keysProcessed[GLFW_KEY_T] = GL_TRUE;
+    }
+    if (!m_keys[GLFW_KEY_T]) {
+        m_keysProcessed[GLFW_KEY_T] = GL_FALSE;
+    }
+    // full, half and quarter particle resolution
+    if (m_keys[GLFW_KEY_R] && !m_keysProcessed[GLFW_KEY_R]) {
+        const GLuint divisor = m_particleTarget.GetDivisor() == 4 ? 1 : m_particleTarget.GetDivisor() * 2;
+        m_particleTarget.SetDivisor(divisor);
+        std::cout << "Particle resolution: 1/" << divisor << std::endl;
+        m_keysProcessed[GLFW_KEY_R] = GL_TRUE;
+    }
+    if (!m_keys[GLFW_KEY_R]) {
+        m_keysProcessed[GLFW_KEY_R] = GL_FALSE;
+    }
+    // overdraw heatmap and stats
+    if (m_keys[GLFW_KEY_O] && !m_keysProcessed[GLFW_KEY_O]) {
+        m_toggleOverdraw = GL_TRUE;
+        m_keysProcessed[GLFW_KEY_O] = GL_TRUE;
+    }
+    if (!m_keys[GLFW_KEY_O]) {
+        m_keysProcessed[GLFW_KEY_O] = GL_FALSE;
+    }
+
     m_camera.ProcessMouseMovement(m_mouseXOffset, m_mouseYOffset);
     m_camera.ProcessMouseScroll(m_scrollYOffset);
 
@@ -125,23 +585,3 @@ void Game::ProcessInput(GLfloat dt)
     m_scrollXOffset = 0.0f;
     m_scrollYOffset = 0.0f;
 }
-
-void Game::Render()
-{
-    if (m_state == GameState::active)
-    {
-        // Update projection and view matrices
-        const glm::mat4 projection = glm::perspective(
-            m_camera.GetZoom(),
-            static_cast<GLfloat>(m_width) / static_cast<GLfloat>(m_height), 0.1f,
-            100.0f);
-        const glm::mat4 view = m_camera.GetViewMatrix();
-        ResourceManager::GetShader("particle").Use().SetMatrix4("projection", projection);
-        ResourceManager::GetShader("particle").SetMatrix4("view", view);
-
-        // Draw particles
-        if (m_ptrParticles) {
-            m_ptrParticles->Draw();
-        }
-    }
-}
@@ -13,9 +13,20 @@
 
 #include <memory>
 #include <random>
+#include <unordered_map>
+#include <vector>
 
 #include "camera.h"
+#include "density_grid.h"
 #include "emitter.h"
+#include "emitter_manager.h"
+#include "fire_grid.h"
+#include "frame_uniforms.h"
+#include "overdraw_meter.h"
+#include "particle_commands.h"
+#include "particle_target.h"
+#include "shared_frames.h"
+#include "task_graph.h"
 
 #define N_KEYS 1024
 
@@ -42,10 +53,11 @@ public:
     ~Game();
     // Initialize game state (load all shaders/textures/levels)
     void Init();
-    // GameLoop
-    void ProcessInput(GLfloat dt);
-    void Update(GLfloat dt);
-    void Render();
+    // GameLoop, one task graph per frame: input, simulation, culling,
+    // buffer fills and the GL work pinned to the calling thread
+    void Frame(GLfloat dt);
+    // Per-task timings of the last frame, 'T' prints them
+    const std::vector<TaskTiming>& GetFrameTimings() const { return m_frame.GetTimings(); }
 
     void SetState(GameState state) { m_state = state; }
     void SetKey(size_t key, GLboolean value) { m_keys[key] = value; }
@@ -53,13 +65,54 @@ public:
     void SetWidth(GLuint width) { m_width = width; }
     void SetHeight(GLuint height) { m_height = height; }
 
+    // Particles drawn at 1/divisor of the screen resolution per axis,
+    // 1, 2 or 4. 'R' cycles through them
+    void SetParticleResolution(GLuint divisor) { m_particleTarget.SetDivisor(divisor); }
+    GLuint GetParticleResolution() const { return m_particleTarget.GetDivisor(); }
+    // Overdraw of the particles, measured while 'O' shows the heatmap
+    const OverdrawStats& GetOverdrawStats() const { return m_overdrawMeter.GetStats(); }
+
+    // Publishes the particles of every frame to shared memory under name,
+    // for any number of viewers. After Init
+    bool Publish(const std::string& name);
+    // Viewer mode: draws the frames of the publisher at name instead of
+    // simulating. After Init
+    bool View(const std::string& name);
+
+    // Splats the particles of every simulated frame into a density and
+    // temperature grid over the fluid domain and streams it to the file at
+    // path, see DensityWriter. After Init
+    bool ExportDensity(const std::string& path);
+
+    // For gameplay and script threads, drained once per simulated frame
+    ParticleCommandQueue& GetCommands() { return m_commands; }
+
     void SetMouseMovement(GLfloat xoffset, GLfloat yoffset);
     void SetMouseScroll(GLfloat xoffset, GLfloat yoffset);
 
 private:
+    void ProcessInput(GLfloat dt);
+    // Camera matrices and the frame uniform buffer
+    void UpdateCamera();
+    // Builds the burnable scene and sets its center on fire
+    void InitFire(const glm::vec3& center);
+    // Steps the fire, creates emitters for blocks that caught fire and
+    // extinguishes the ones of blocks that went out. Emitters created
+    // here join the frame graph of the next frame
+    void UpdateFires(GLfloat dt);
+    // Ignites, bursts, moves or extinguishes a scripted fire
+    void ApplyCommand(const ParticleCommand& command);
+    // Prints the timings of the last frame grouped by task name
+    void PrintFrameTimings() const;
+
     // Game state
     GameState m_state;
     GLboolean m_keys[N_KEYS] = {GL_FALSE};
+    // set while a toggle key is held, so it fires once per press
+    GLboolean m_keysProcessed[N_KEYS] = {GL_FALSE};
+    GLboolean m_printTimings;
+    // applied by the particles task, the meter needs the GL context
+    GLboolean m_toggleOverdraw;
 
     GLfloat m_mouseXOffset;
     GLfloat m_mouseYOffset;
@@ -71,9 +124,42 @@ private:
     GLuint m_height;
 
     Camera m_camera;
+    FrameUniforms m_frameUniforms;
+    ParticleTarget m_particleTarget;
+    OverdrawMeter m_overdrawMeter;
+    // of the current frame, set by UpdateCamera
+    Frustum m_frustum;
+    // screen size of one unit at distance 1, for the simulation LOD
+    GLfloat m_pixelsPerUnit;
+    TaskGraph m_frame;
+    size_t m_nSimulatedFrames;
+
+    // at most one of them, see Publish and View
+    std::unique_ptr<SharedFramePublisher> m_ptrPublisher;
+    std::unique_ptr<SharedFrameViewer> m_ptrViewer;
+    // see ExportDensity
+    std::unique_ptr<DensityGrid> m_ptrDensity;
+    std::unique_ptr<DensityWriter> m_ptrDensityWriter;
 
     // Game-related State data
-    std::unique_ptr<Emitter> m_ptrParticles;
+    std::unique_ptr<FluidGrid> m_ptrFluid;
+    std::unique_ptr<CurlNoise> m_ptrNoise;
+    std::unique_ptr<FireGrid> m_ptrFire;
+    // all fire emitters, burning and burning out
+    EmitterManager m_emitters;
+    // per burning block of m_ptrFire
+    std::unordered_map<GLuint, EmitterHandle> m_fires;
+    // sub-emitter of all fires, embers rising from dying flames
+    EmitterHandle m_embers;
+    // fires created through m_commands, by their id
+    struct ScriptedFire {
+        EmitterHandle handle;
+        GLuint particlesPerFrame;
+    };
+    ParticleCommandQueue m_commands;
+    std::unordered_map<GLuint, ScriptedFire> m_scriptedFires;
+    // emitter seeds, counts every ignition so far
+    GLuint m_nIgnitions;
     std::default_random_engine m_rndGenerator;
 
     FPSMeter m_fpsMeter;
@@ -10,6 +10,9 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <iostream>
+#include <string>
+
 #include "game.h"
 #include "resource_manager.h"
 
@@ -59,6 +62,21 @@ int main(int argc, char *argv[])
 
     // Initialize game
     Breakout.Init();
+    // -publish <name> shares the particles of every frame with viewers
+    // started with -view <name>, which skip the simulation. -density <file>
+    // streams the particle density of every frame to file
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+        if (option == "-publish") {
+            Breakout.Publish(argv[i + 1]);
+        } else if (option == "-view") {
+            Breakout.View(argv[i + 1]);
+        } else if (option == "-density") {
+            Breakout.ExportDensity(argv[i + 1]);
+        } else {
+            std::cout << "Unknown option: " << option << std::endl;
+        }
+    }
 
     // DeltaTime variables
     GLfloat deltaTime = 0.0f;
@@ -76,16 +94,10 @@ int main(int argc, char *argv[])
         glfwPollEvents();
 
         //deltaTime = 0.001f;
-        // Manage user input
-        Breakout.ProcessInput(deltaTime);
-
-        // Update Game state
-        Breakout.Update(deltaTime);
-
-        // Render
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        Breakout.Render();
+        // Input, update and render as one task graph
+        Breakout.Frame(deltaTime);
 
         glfwSwapBuffers(window);
     }
@@ -0,0 +1,331 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool EndsWith(const std::string& str, const std::string& suffix)
+{
+    if (str.size() < suffix.size()) {
+        return false;
+    }
+    return std::equal(suffix.rbegin(), suffix.rend(), str.rbegin(),
+                      [](char a, char b) { return std::tolower(a) == std::tolower(b); });
+}
+
+// Fan-triangulates a polygon given as vertex indices
+void AddPolygon(const std::vector<GLuint>& polygon, std::vector<glm::uvec3>& triangles)
+{
+    for (size_t i = 2; i < polygon.size(); ++i) {
+        triangles.push_back(glm::uvec3(polygon[0], polygon[i - 1], polygon[i]));
+    }
+}
+
+// Size in bytes of a PLY scalar type, 0 if unknown
+size_t PlyTypeSize(const std::string& type)
+{
+    if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+        return 1;
+    if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+        return 2;
+    if (type == "int" || type == "uint" || type == "float" || type == "int32" ||
+        type == "uint32" || type == "float32")
+        return 4;
+    if (type == "double" || type == "float64")
+        return 8;
+    return 0;
+}
+
+// Reads one binary little endian PLY scalar as double
+double ReadPlyScalar(std::istream& stream, const std::string& type)
+{
+    unsigned char bytes[8] = {0};
+    const size_t size = PlyTypeSize(type);
+    stream.read(reinterpret_cast<char*>(bytes), size);
+
+    if (type == "float" || type == "float32") {
+        float value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    if (type == "double" || type == "float64") {
+        double value;
+        std::memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+    const bool isSigned = type[0] != 'u';
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    if (isSigned && size < 8 && (value >> (8 * size - 1)) & 1) {
+        value |= ~uint64_t(0) << (8 * size);
+    }
+    return isSigned ? static_cast<double>(static_cast<int64_t>(value))
+                    : static_cast<double>(value);
+}
+
+struct PlyProperty {
+    std::string name;
+    std::string type;
+    // list properties only
+    std::string countType;
+    bool isList = false;
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+};
+
+} // namespace
+
+TriangleMesh TriangleMesh::Load(const std::string& file)
+{
+    if (EndsWith(file, ".ply")) {
+        return LoadPLY(file);
+    }
+    if (EndsWith(file, ".obj")) {
+        return LoadOBJ(file);
+    }
+    std::cout << "ERROR::MESH: Unsupported mesh format: " << file << std::endl;
+    return TriangleMesh();
+}
+
+TriangleMesh TriangleMesh::LoadOBJ(const std::string& file)
+{
+    TriangleMesh mesh;
+    std::ifstream stream(file);
+    if (!stream) {
+        std::cout << "Failed to load mesh at path: " << file << std::endl;
+        return mesh;
+    }
+
+    std::string line;
+    std::vector<GLuint> polygon;
+    while (std::getline(stream, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "v") {
+            glm::vec3 vertex;
+            tokens >> vertex.x >> vertex.y >> vertex.z;
+            mesh.Vertices.push_back(vertex);
+        } else if (keyword == "f") {
+            polygon.clear();
+            std::string corner;
+            while (tokens >> corner) {
+                // "v", "v/vt", "v//vn" or "v/vt/vn", negative is relative
+                long index = std::strtol(corner.c_str(), nullptr, 10);
+                if (index < 0) {
+                    index += static_cast<long>(mesh.Vertices.size()) + 1;
+                }
+                if (index < 1 || static_cast<size_t>(index) > mesh.Vertices.size()) {
+                    continue;
+                }
+                polygon.push_back(static_cast<GLuint>(index - 1));
+            }
+            AddPolygon(polygon, mesh.Triangles);
+        }
+    }
+    return mesh;
+}
+
+TriangleMesh TriangleMesh::LoadPLY(const std::string& file)
+{
+    TriangleMesh mesh;
+    std::ifstream stream(file, std::ios::binary);
+    std::string line;
+    if (!stream || !std::getline(stream, line) || line.compare(0, 3, "ply") != 0) {
+        std::cout << "Failed to load mesh at path: " << file << std::endl;
+        return mesh;
+    }
+
+    // 1. Header
+    std::string format;
+    std::vector<PlyElement> elements;
+    while (std::getline(stream, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+        tokens >> keyword;
+        if (keyword == "format") {
+            tokens >> format;
+        } else if (keyword == "element") {
+            PlyElement element;
+            tokens >> element.name >> element.count;
+            elements.push_back(element);
+        } else if (keyword == "property" && !elements.empty()) {
+            PlyProperty property;
+            tokens >> property.type;
+            if (property.type == "list") {
+                property.isList = true;
+                tokens >> property.countType >> property.type;
+            }
+            tokens >> property.name;
+            elements.back().properties.push_back(property);
+        } else if (keyword == "end_header") {
+            break;
+        }
+    }
+
+    const bool ascii = format == "ascii";
+    if (!ascii && format != "binary_little_endian") {
+        std::cout << "ERROR::MESH: Unsupported PLY format " << format << ": " << file << std::endl;
+        return mesh;
+    }
+
+    // 2. Body, element by element in header order
+    std::vector<double> values;
+    std::vector<GLuint> polygon;
+    for (const auto& element : elements) {
+        for (size_t item = 0; item < element.count && stream; ++item) {
+            glm::vec3 vertex(0.0f);
+            polygon.clear();
+            for (const auto& property : element.properties) {
+                values.clear();
+                size_t count = 1;
+                if (property.isList) {
+                    double n = 0.0;
+                    if (ascii)
+                        stream >> n;
+                    else
+                        n = ReadPlyScalar(stream, property.countType);
+                    count = static_cast<size_t>(n);
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    double value = 0.0;
+                    if (ascii)
+                        stream >> value;
+                    else
+                        value = ReadPlyScalar(stream, property.type);
+                    values.push_back(value);
+                }
+
+                if (element.name == "vertex" && !property.isList) {
+                    if (property.name == "x")
+                        vertex.x = values[0];
+                    else if (property.name == "y")
+                        vertex.y = values[0];
+                    else if (property.name == "z")
+                        vertex.z = values[0];
+                } else if (element.name == "face" && property.isList &&
+                           (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                    for (double index : values) {
+                        polygon.push_back(static_cast<GLuint>(index));
+                    }
+                }
+            }
+            if (element.name == "vertex") {
+                mesh.Vertices.push_back(vertex);
+            } else if (element.name == "face") {
+                AddPolygon(polygon, mesh.Triangles);
+            }
+        }
+    }
+
+    // Drop faces pointing past the vertex list of a truncated file
+    const GLuint nVertices = mesh.Vertices.size();
+    mesh.Triangles.erase(
+        std::remove_if(mesh.Triangles.begin(), mesh.Triangles.end(),
+                       [nVertices](const glm::uvec3& t) {
+                           return t.x >= nVertices || t.y >= nVertices || t.z >= nVertices;
+                       }),
+        mesh.Triangles.end());
+    return mesh;
+}
+
+SurfaceSampler::SurfaceSampler(const TriangleMesh& mesh)
+    : m_area(0.0f)
+{
+    const size_t nTriangles = mesh.Triangles.size();
+    m_origins.reserve(nTriangles);
+    m_edges1.reserve(nTriangles);
+    m_edges2.reserve(nTriangles);
+
+    std::vector<double> areas;
+    areas.reserve(nTriangles);
+    double totalArea = 0.0;
+    for (const auto& triangle : mesh.Triangles) {
+        const glm::vec3& a = mesh.Vertices[triangle.x];
+        const glm::vec3 e1 = mesh.Vertices[triangle.y] - a;
+        const glm::vec3 e2 = mesh.Vertices[triangle.z] - a;
+        const double area = 0.5 * glm::length(glm::cross(e1, e2));
+        // degenerate triangles can never be picked, skip them
+        if (area <= 0.0) {
+            continue;
+        }
+        m_origins.push_back(a);
+        m_edges1.push_back(e1);
+        m_edges2.push_back(e2);
+        areas.push_back(area);
+        totalArea += area;
+    }
+    m_area = totalArea;
+
+    // Vose's alias method, O(n) construction
+    const size_t n = areas.size();
+    m_probability.assign(n, 1.0f);
+    m_alias.resize(n);
+    std::vector<double> scaled(n);
+    std::vector<GLuint> small, large;
+    for (size_t i = 0; i < n; ++i) {
+        scaled[i] = areas[i] * n / totalArea;
+        m_alias[i] = i;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        const GLuint less = small.back();
+        small.pop_back();
+        const GLuint more = large.back();
+        m_probability[less] = scaled[less];
+        m_alias[less] = more;
+        // the large bucket donates what fills up the small one
+        scaled[more] -= 1.0 - scaled[less];
+        if (scaled[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // leftovers are 1.0 up to rounding errors, already set
+}
+
+void SurfaceSampler::Sample(size_t n, const GLfloat* uniforms, const glm::mat4& transform,
+                            std::vector<glm::vec3>& out) const
+{
+    if (Empty() || n == 0) {
+        return;
+    }
+
+    // reused between calls, one per thread
+    thread_local std::vector<GLuint> picked;
+    picked.resize(n);
+
+    // 1. Alias table lookup: column from the first number, coin from the second
+    const GLuint nTriangles = m_origins.size();
+    for (size_t i = 0; i < n; ++i) {
+        const GLuint column = std::min(static_cast<GLuint>(uniforms[4 * i] * nTriangles), nTriangles - 1);
+        picked[i] = uniforms[4 * i + 1] < m_probability[column] ? column : m_alias[column];
+    }
+
+    // 2. Uniform point in the triangle, folding the unit square onto it
+    const size_t first = out.size();
+    out.resize(first + n);
+    for (size_t i = 0; i < n; ++i) {
+        GLfloat u = uniforms[4 * i + 2];
+        GLfloat v = uniforms[4 * i + 3];
+        const bool fold = u + v > 1.0f;
+        u = fold ? 1.0f - u : u;
+        v = fold ? 1.0f - v : v;
+        const GLuint t = picked[i];
+        const glm::vec3 local = m_origins[t] + u * m_edges1[t] + v * m_edges2[t];
+        out[first + i] = glm::vec3(transform * glm::vec4(local, 1.0f));
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Indexed triangle mesh loaded from Wavefront OBJ or PLY (ascii or
+// binary little endian). Polygons are fan-triangulated, everything but
+// positions is ignored.
+class TriangleMesh {
+public:
+    std::vector<glm::vec3> Vertices;
+    std::vector<glm::uvec3> Triangles;
+
+    // Picks the loader from the file extension. Prints an error and
+    // returns an empty mesh on failure
+    static TriangleMesh Load(const std::string& file);
+    static TriangleMesh LoadOBJ(const std::string& file);
+    static TriangleMesh LoadPLY(const std::string& file);
+
+    bool Empty() const { return Triangles.empty(); }
+};
+
+// Draws uniformly distributed points on the surface of a mesh. Triangles
+// are picked proportionally to their area through a Walker alias table,
+// so a sample costs O(1) whatever the triangle count.
+class SurfaceSampler {
+public:
+    explicit SurfaceSampler(const TriangleMesh& mesh);
+
+    // Appends n points, transformed by transform, to out. uniforms holds
+    // 4 numbers in [0, 1) per point. Triangle picks and positions are
+    // produced in separate passes over flat arrays so the loops stay
+    // branch free
+    void Sample(size_t n, const GLfloat* uniforms, const glm::mat4& transform,
+                std::vector<glm::vec3>& out) const;
+
+    GLfloat GetArea() const { return m_area; }
+    bool Empty() const { return m_origins.empty(); }
+
+private:
+    // per triangle: first vertex and the two edges leaving it
+    std::vector<glm::vec3> m_origins;
+    std::vector<glm::vec3> m_edges1;
+    std::vector<glm::vec3> m_edges2;
+
+    // alias table: keep triangle i with probability m_probability[i],
+    // otherwise take m_alias[i]
+    std::vector<GLfloat> m_probability;
+    std::vector<GLuint> m_alias;
+
+    GLfloat m_area;
+};
@@ -0,0 +1,215 @@
+// Headless micro benchmarks of single passes, on synthetic particles so
+// the numbers quoted in commits can be reproduced on any machine.
+//
+//   fire_microbench density [-n particles] [-r resolution] [-f frames]
+//   fire_microbench hash [-n particles] [-f frames]
+//
+// density: splats n particles (default 1M) of a fire shaped plume into a
+// resolution^3 grid (default 256) and streams every frame to a density
+// file, reporting the time of the splat and of the encode per frame and
+// the size of a frame against raw floats.
+//
+// hash: rebuilds a SpatialHash over n uniformly random particles every
+// frame, reporting the rebuild time, then checks radius queries around
+// some of them against brute force. Exit code 1 if any query differs.
+//
+// Exit code 2 means bad input.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "density_grid.h"
+#include "spatial_hash.h"
+#include "thread_pool.h"
+
+#define DEFAULT_PARTICLES 1000000
+#define DEFAULT_RESOLUTION 256
+#define DEFAULT_FRAMES 20
+// world units per density cell
+#define CELL_SIZE 0.1f
+#define DENSITY_FILE "microbench.fden"
+// particles within the query radius on average, and queries checked
+#define HASH_NEIGHBORS 32
+#define HASH_CHECKS 100
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double Milliseconds(Clock::time_point begin, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+struct Timings {
+    std::vector<double> ms;
+
+    void Print(const char* name) const
+    {
+        std::vector<double> sorted = ms;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double t : sorted) {
+            sum += t;
+        }
+        const size_t p99 = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+        std::printf("%-10s mean %8.2f ms  p99 %8.2f ms\n", name, sum / sorted.size(), sorted[p99]);
+    }
+};
+
+int Usage()
+{
+    std::cout << "usage: fire_microbench density [-n particles] [-r resolution] [-f frames]\n"
+              << "       fire_microbench hash [-n particles] [-f frames]" << std::endl;
+    return 2;
+}
+
+int Density(size_t nParticles, int resolution, size_t nFrames)
+{
+    // 1. A plume over the center of the grid, fading with height, moving
+    // up a little every frame
+    const GLfloat extent = resolution * CELL_SIZE;
+    std::mt19937 rng(1);
+    std::normal_distribution<GLfloat> spread(0.0f, extent / 16.0f);
+    std::exponential_distribution<GLfloat> rise(4.0f / extent);
+    std::vector<glm::vec3> positions(nParticles);
+    std::vector<GLfloat> masses(nParticles);
+    std::vector<GLfloat> temperatures(nParticles);
+    for (size_t i = 0; i < nParticles; ++i) {
+        const GLfloat height = rise(rng);
+        positions[i] = glm::vec3(0.5f * extent + spread(rng), 0.05f * extent + height,
+                                 0.5f * extent + spread(rng));
+        temperatures[i] = std::max(0.0f, 1.0f - height / extent);
+        masses[i] = 0.001f * temperatures[i];
+    }
+
+    DensityGrid grid(glm::ivec3(resolution), CELL_SIZE, glm::vec3(0.0f));
+    DensityWriter writer;
+    if (!writer.Open(DENSITY_FILE, grid)) {
+        return 2;
+    }
+
+    // 2. Splat and encode, the write itself overlaps the next frame
+    Timings splat;
+    Timings encode;
+    size_t rawBytes = 0;
+    for (size_t frame = 0; frame < nFrames; ++frame) {
+        for (glm::vec3& position : positions) {
+            position.y += 0.25f * CELL_SIZE;
+        }
+        const Clock::time_point begin = Clock::now();
+        grid.Splat(positions.data(), masses.data(), temperatures.data(), nParticles);
+        const Clock::time_point splatted = Clock::now();
+        writer.Write(grid, 1.0f / 60.0f);
+        const Clock::time_point encoded = Clock::now();
+        splat.ms.push_back(Milliseconds(begin, splatted));
+        encode.ms.push_back(Milliseconds(splatted, encoded));
+        rawBytes += 2 * sizeof(GLfloat) * DensityGrid::BRICK_CELLS * grid.GetActiveBricks().size();
+    }
+    writer.Close();
+    std::remove(DENSITY_FILE);
+
+    std::printf("%zu particles, %d^3 cells, %zu frames, %zu threads, %zu active bricks\n",
+                nParticles, resolution, nFrames, ThreadPool::Instance().Size() + 1,
+                grid.GetActiveBricks().size());
+    splat.Print("splat");
+    encode.Print("encode");
+    std::printf("%-10s %8.2f MB per frame, %.1fx smaller than raw floats\n", "file",
+                writer.GetBytesWritten() / (1048576.0 * nFrames),
+                static_cast<double>(rawBytes) / writer.GetBytesWritten());
+    return 0;
+}
+
+int Hash(size_t nParticles, size_t nFrames)
+{
+    // 1. Uniform particles in a cube sized for HASH_NEIGHBORS within the
+    // radius, which is the cell size like Emitter::SetInteraction uses it
+    const GLfloat radius = 0.1f;
+    const GLfloat sphere = 4.0f / 3.0f * 3.14159265f * radius * radius * radius;
+    const GLfloat extent = std::cbrt(nParticles * sphere / HASH_NEIGHBORS);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<GLfloat> uniform(0.0f, extent);
+    std::vector<glm::vec3> positions(nParticles);
+    for (glm::vec3& position : positions) {
+        position = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+    }
+
+    // 2. Rebuilds, the particles rise a little every frame
+    SpatialHash hash(radius);
+    Timings build;
+    for (size_t frame = 0; frame < nFrames; ++frame) {
+        for (glm::vec3& position : positions) {
+            position.y += 0.1f * radius;
+        }
+        const Clock::time_point begin = Clock::now();
+        hash.Build(positions.data(), nParticles);
+        build.ms.push_back(Milliseconds(begin, Clock::now()));
+    }
+
+    // 3. Queries against brute force
+    std::vector<GLuint> found;
+    std::vector<GLuint> expected;
+    size_t nWrong = 0;
+    size_t nNeighbors = 0;
+    for (size_t check = 0; check < HASH_CHECKS; ++check) {
+        const glm::vec3& position = positions[check * nParticles / HASH_CHECKS];
+        found.clear();
+        expected.clear();
+        hash.Query(position, radius, found);
+        for (size_t i = 0; i < nParticles; ++i) {
+            const glm::vec3 offset = position - positions[i];
+            if (glm::dot(offset, offset) <= radius * radius) {
+                expected.push_back(static_cast<GLuint>(i));
+            }
+        }
+        std::sort(found.begin(), found.end());
+        nWrong += found != expected;
+        nNeighbors += expected.size();
+    }
+
+    std::printf("%zu particles, %zu frames, %zu threads, %.1f neighbors per query\n", nParticles,
+                nFrames, ThreadPool::Instance().Size() + 1,
+                static_cast<double>(nNeighbors) / HASH_CHECKS);
+    build.Print("build");
+    std::printf("%-10s %zu of %d differ from brute force\n", "queries", nWrong, HASH_CHECKS);
+    return nWrong == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        return Usage();
+    }
+    const std::string pass = argv[1];
+    size_t nParticles = DEFAULT_PARTICLES;
+    int resolution = DEFAULT_RESOLUTION;
+    size_t nFrames = DEFAULT_FRAMES;
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+            nParticles = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "-r" && i + 1 < argc)
+            resolution = std::atoi(argv[++i]);
+        else if (arg == "-f" && i + 1 < argc)
+            nFrames = std::strtoull(argv[++i], nullptr, 10);
+        else
+            return Usage();
+    }
+    if (nParticles == 0 || resolution <= 0 || nFrames == 0) {
+        return Usage();
+    }
+
+    if (pass == "density")
+        return Density(nParticles, resolution, nFrames);
+    if (pass == "hash")
+        return Hash(nParticles, nFrames);
+    return Usage();
+}
@@ -0,0 +1,165 @@
+#include "overdraw_meter.h"
+
+#include <algorithm>
+#include <iostream>
+
+// fragments per pixel shown as the hottest color
+#define HEATMAP_RANGE 64.0f
+
+OverdrawMeter::OverdrawMeter()
+    : m_enabled(false),
+      m_time(0.0f),
+      m_screenWidth(0),
+      m_screenHeight(0),
+      m_width(0),
+      m_height(0),
+      m_FBO(0),
+      m_texture(0),
+      m_VAO(0)
+{
+}
+
+OverdrawMeter::~OverdrawMeter()
+{
+    Release();
+    if (m_VAO != 0) {
+        glDeleteVertexArrays(1, &m_VAO);
+    }
+}
+
+void OverdrawMeter::Init(const Shader& heatmap, const std::vector<Shader>& particleShaders)
+{
+    m_heatmap = heatmap;
+    m_heatmap.Use().SetInteger("overdraw", 0);
+    m_heatmap.SetFloat("range", HEATMAP_RANGE);
+    m_particleShaders = particleShaders;
+    glCreateVertexArrays(1, &m_VAO);
+}
+
+void OverdrawMeter::SetEnabled(bool enabled)
+{
+    m_enabled = enabled;
+    m_time = 0.0f;
+    for (Shader& shader : m_particleShaders) {
+        shader.Use().SetInteger("overdraw", enabled);
+    }
+}
+
+void OverdrawMeter::Begin(GLuint width, GLuint height, GLuint divisor)
+{
+    m_screenWidth = width;
+    m_screenHeight = height;
+    const GLuint targetWidth = std::max(width / divisor, 1u);
+    const GLuint targetHeight = std::max(height / divisor, 1u);
+    if (targetWidth != m_width || targetHeight != m_height || m_FBO == 0) {
+        m_width = targetWidth;
+        m_height = targetHeight;
+        Allocate();
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+    glViewport(0, 0, m_width, m_height);
+    const GLfloat zero[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearNamedFramebufferfv(m_FBO, GL_COLOR, 0, zero);
+}
+
+void OverdrawMeter::End()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_screenWidth, m_screenHeight);
+    Measure();
+
+    // Opaque, the heatmap replaces the scene
+    glDisable(GL_BLEND);
+    m_heatmap.Use();
+    glBindTextureUnit(0, m_texture);
+    glBindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glEnable(GL_BLEND);
+}
+
+void OverdrawMeter::Count(GLfloat dt)
+{
+    if (!m_enabled) {
+        return;
+    }
+    m_time += dt;
+    if (m_time < 1.0f) {
+        return;
+    }
+    m_time = 0.0f;
+    std::cout << "Overdraw at " << m_stats.width << "x" << m_stats.height
+              << ": average " << m_stats.average << ", covered average "
+              << m_stats.averageCovered << ", max " << m_stats.max << std::endl;
+    std::cout << "  histogram:";
+    for (size_t i = 0; i < OVERDRAW_BUCKETS; ++i) {
+        if (i < 2) {
+            std::cout << " " << i;
+        } else if (i + 1 < OVERDRAW_BUCKETS) {
+            std::cout << " " << (1u << (i - 1)) << "-" << (1u << i) - 1;
+        } else {
+            std::cout << " " << (1u << (i - 1)) << "+";
+        }
+        std::cout << ":" << m_stats.histogram[i];
+    }
+    std::cout << std::endl;
+}
+
+void OverdrawMeter::Measure()
+{
+    m_counts.resize(m_width * m_height);
+    glGetTextureImage(m_texture, 0, GL_RED, GL_FLOAT, m_counts.size() * sizeof(GLfloat),
+                      m_counts.data());
+
+    m_stats = OverdrawStats();
+    m_stats.width = m_width;
+    m_stats.height = m_height;
+    double total = 0.0;
+    size_t nCovered = 0;
+    for (const GLfloat value : m_counts) {
+        const GLuint count = static_cast<GLuint>(value + 0.5f);
+        total += count;
+        m_stats.max = std::max(m_stats.max, count);
+        size_t bucket = 0;
+        while (bucket + 1 < OVERDRAW_BUCKETS && (count >> bucket) != 0) {
+            ++bucket;
+        }
+        ++m_stats.histogram[bucket];
+        nCovered += count != 0;
+    }
+    m_stats.average = m_counts.empty() ? 0.0 : total / m_counts.size();
+    m_stats.averageCovered = nCovered == 0 ? 0.0 : total / nCovered;
+}
+
+void OverdrawMeter::Allocate()
+{
+    Release();
+
+    // float blending counts exactly up to 2^24 fragments
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+    glTextureStorage2D(m_texture, 1, GL_R32F, m_width, m_height);
+    glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glCreateFramebuffers(1, &m_FBO);
+    glNamedFramebufferTexture(m_FBO, GL_COLOR_ATTACHMENT0, m_texture, 0);
+    if (glCheckNamedFramebufferStatus(m_FBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::OVERDRAW_METER: Framebuffer not complete at " << m_width << "x"
+                  << m_height << std::endl;
+    }
+}
+
+void OverdrawMeter::Release()
+{
+    if (m_FBO != 0) {
+        glDeleteFramebuffers(1, &m_FBO);
+        m_FBO = 0;
+    }
+    if (m_texture != 0) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+}
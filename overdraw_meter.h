@@ -0,0 +1,75 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+#include <vector>
+
+#include "shader.h"
+
+// Histogram buckets: 0, 1, 2-3, 4-7, ... and 512 or more
+#define OVERDRAW_BUCKETS 11
+
+// Overdraw of the last measured frame, counts are fragments per pixel
+struct OverdrawStats {
+    GLuint width = 0;
+    GLuint height = 0;
+    // over all pixels and over the pixels with at least one fragment
+    double average = 0.0;
+    double averageCovered = 0.0;
+    GLuint max = 0;
+    // pixels per bucket, bucket i > 0 counts [2^(i-1), 2^i)
+    std::array<size_t, OVERDRAW_BUCKETS> histogram = {};
+};
+
+// Diagnostic view counting the particle fragments of every pixel. The
+// particle shaders write 1 in overdraw mode and the emitters blend
+// additively, so an R32F target ends up with the fragment count. End
+// shows it as a heatmap instead of the particles and reads it back for
+// the stats, which stalls the pipeline, diagnostics only
+class OverdrawMeter {
+public:
+    // No GL calls here, Game is constructed before the context exists
+    OverdrawMeter();
+    ~OverdrawMeter();
+
+    OverdrawMeter(const OverdrawMeter&) = delete;
+    OverdrawMeter& operator=(const OverdrawMeter&) = delete;
+
+    // heatmap draws a fullscreen triangle sampling unit 0, particle
+    // shaders get their "overdraw" uniform switched by SetEnabled
+    void Init(const Shader& heatmap, const std::vector<Shader>& particleShaders);
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const { return m_enabled; }
+
+    // Counts at 1/divisor of the screen resolution per axis, the same
+    // fragments the particle pass would cost at that divisor
+    void Begin(GLuint width, GLuint height, GLuint divisor);
+    // Draws the heatmap and updates the stats
+    void End();
+    // Prints the stats once a second while enabled
+    void Count(GLfloat dt);
+
+    const OverdrawStats& GetStats() const { return m_stats; }
+
+private:
+    void Allocate();
+    void Release();
+    void Measure();
+
+    Shader m_heatmap;
+    std::vector<Shader> m_particleShaders;
+    bool m_enabled;
+    GLfloat m_time;
+
+    GLuint m_screenWidth;
+    GLuint m_screenHeight;
+    GLuint m_width;
+    GLuint m_height;
+    GLuint m_FBO;
+    GLuint m_texture;
+    GLuint m_VAO;
+
+    std::vector<GLfloat> m_counts;
+    OverdrawStats m_stats;
+};
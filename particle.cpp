@@ -3,19 +3,23 @@
 #include <iostream>
 #include <algorithm>
 
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/vector_angle.hpp>
 
 Particle::Particle(const glm::vec3& position, const glm::vec3& velocity,
-                   const glm::vec4& color, GLfloat fLife, GLfloat fScale)
+                   GLubyte color, GLfloat fLife, GLfloat fScale,
+                   GLubyte layer)
     : m_position(position),
       m_velocity(-velocity),
-      m_acceleration(glm::normalize(m_velocity) * 0.02f),
+      m_age(MAX_AGE),
+      m_lifeMs(std::clamp(fLife * 1000.0f + 0.5f, 0.0f, static_cast<GLfloat>(UINT16_MAX))),
+      m_scale(glm::packHalf1x16(fScale)),
       m_color(color),
-      m_fLife(fLife),
-      m_fScale(fScale),
-      m_fInitialLife(m_fLife),
-      m_fInitialScale(m_fScale)
+      m_layer(layer)
 {
+    if (m_lifeMs > 0) {
+        m_age = 0;
+    }
 }
 
 const glm::vec3& Particle::GetPosition() const
@@ -23,66 +27,105 @@ const glm::vec3& Particle::GetPosition() const
     return m_position;
 }
 
-const glm::vec4& Particle::GetColor() const
+const glm::vec3& Particle::GetVelocity() const
+{
+    return m_velocity;
+}
+
+GLubyte Particle::GetColor() const
 {
     return m_color;
 }
 
+GLfloat Particle::GetAlpha() const
+{
+    return Remaining();
+}
+
 GLfloat Particle::GetScale() const
 {
-    return m_fScale;
+    return GetSpawnScale() * Remaining();
 }
 
-bool Particle::IsAlive()
+GLfloat Particle::GetSpawnScale() const
 {
-    return m_fLife > 0.0f;
-};
+    return glm::unpackHalf1x16(m_scale);
+}
 
-void Particle::UpdateColor()
+GLfloat Particle::GetAge() const
 {
-    m_color.a = m_fLife / m_fInitialLife;
+    return m_age * (1.0f / MAX_AGE);
 }
 
-void Particle::UpdateScale()
+GLuint Particle::GetLayer() const
 {
-    m_fScale = m_fInitialScale * (m_fLife / m_fInitialLife);
+    return m_layer;
 }
 
-void Particle::UpdatePosition(GLfloat dt)
+GLfloat Particle::GetLife() const
 {
-    m_position += m_velocity * dt;
+    return m_lifeMs * 0.001f * Remaining();
 }
 
-void Particle::UpdateVelocity(const std::vector<glm::vec3>& pressurePoints)
+bool Particle::IsAlive() const
 {
-    const auto& iter = std::upper_bound(
-        pressurePoints.begin(), pressurePoints.end(), m_position,
-        [](const auto& a, const auto& b) {
-        return (glm::length(a) < glm::length(b)) && (a.y < b.y); });
+    return m_age < MAX_AGE;
+}
 
-    if (iter != pressurePoints.end()) {
-        m_velocity =
-            glm::length(m_velocity) * glm::normalize(*iter - m_position) +
-            glm::length(m_acceleration);
-    }
-    else {
-        m_velocity += m_acceleration;
-    }
+void Particle::AddVelocity(const glm::vec3& velocity)
+{
+    m_velocity += velocity;
+}
+
+GLfloat Particle::Remaining() const
+{
+    return 1.0f - GetAge();
+}
+
+void Particle::Advance(GLfloat dt, const glm::vec3& drift)
+{
+    // drift only displaces, it never accumulates into the velocity
+    m_position += (m_velocity + drift) * dt;
 }
 
-bool Particle::Update(GLfloat dt, const std::vector<glm::vec3>& pressurePoints)
+bool Particle::Collide(const glm::vec3& origin, const Collider& collider)
 {
-    // can be the cause of underflow
-    m_fLife -= dt;
-    if (IsAlive()) {
-        // particle is alive, thus update
-        UpdateColor();
-        UpdateScale();
-        UpdatePosition(dt);
-        UpdateVelocity(pressurePoints);
+    // one brick lookup, independent of the scene's triangle count
+    const glm::vec3 position = origin + m_position;
+    const GLfloat radius = 0.5f * GetScale();
+    const GLfloat distance = collider.field->Distance(position);
+    if (distance >= radius) {
+        return true;
+    }
+    if (collider.response == CollisionResponse::kill) {
+        m_age = MAX_AGE;
+        return false;
+    }
+
+    const glm::vec3 gradient = collider.field->Gradient(position);
+    const GLfloat length = glm::length(gradient);
+    if (length <= 0.0f) {
         return true;
     }
-    else {
+    const glm::vec3 normal = gradient / length;
+    m_position += normal * (radius - distance);
+
+    const GLfloat approach = glm::dot(m_velocity, normal);
+    if (approach < 0.0f) {
+        const GLfloat restitution =
+            collider.response == CollisionResponse::bounce ? collider.restitution : 0.0f;
+        m_velocity -= (1.0f + restitution) * approach * normal;
+    }
+    return true;
+}
+
+bool Particle::Age(GLfloat dt)
+{
+    if (!IsAlive()) {
         return false;
     }
+    // age in steps of 1/MAX_AGE of the lifetime
+    const GLfloat aging = dt * (1000.0f * MAX_AGE) / m_lifeMs + 0.5f;
+    m_age = std::min(static_cast<GLfloat>(m_age) + aging, static_cast<GLfloat>(MAX_AGE));
+    return IsAlive();
 }
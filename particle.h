@@ -5,38 +5,65 @@
 #include <GL/glew.h>
 
 #include <glm/glm.hpp>
+#include <cstdint>
 
-#include <vector>
+#include "sdf.h"
 
-// Represents a single particle and its state
+// Represents a single particle and its state in 32 bytes. Anything that
+// can be derived is: alpha and scale follow from the normalized age,
+// the RGB color lives in the emitter's palette and forces come from the
+// emitter's kernel (see emitter_kernel.h), which drives the update
 class Particle {
 public:
+    static const GLuint MAX_AGE = UINT16_MAX;
+
+    // Born dead, fLife <= 0 as well
     Particle(const glm::vec3& position = glm::vec3(0.0f),
              const glm::vec3& velocity = glm::vec3(0.0f),
-             const glm::vec4& color = glm::vec4(1.0f),
+             GLubyte color = 0,
              GLfloat fLife = 0.0f,
-             GLfloat fScale = 0.0f);
+             GLfloat fScale = 0.0f,
+             GLubyte layer = 0);
 
-    bool Update(GLfloat dt, const std::vector<glm::vec3>& m_pressurePoints);
+    // Advances the age, false once the particle is dead
+    bool Age(GLfloat dt);
+    // Moves along the velocity plus a displacement-only drift
+    void Advance(GLfloat dt, const glm::vec3& drift);
+    // Pushes the particle out of the geometry, false if it got killed.
+    // origin is the emitter's world position
+    bool Collide(const glm::vec3& origin, const Collider& collider);
     const glm::vec3& GetPosition() const;
-    const glm::vec4& GetColor() const;
+    const glm::vec3& GetVelocity() const;
+    // Index into the emitter's palette
+    GLubyte GetColor() const;
+    // Fades out over the lifetime
+    GLfloat GetAlpha() const;
+    // Shrinks over the lifetime
     GLfloat GetScale() const;
-    bool IsAlive();
+    GLfloat GetSpawnScale() const;
+    // 0 at birth, 1 when dead
+    GLfloat GetAge() const;
+    GLuint GetLayer() const;
+    // Remaining lifetime in seconds
+    GLfloat GetLife() const;
+    bool IsAlive() const;
+    // Impulse from outside forces, e.g. neighbouring particles
+    void AddVelocity(const glm::vec3& velocity);
 
 private:
-    void UpdateColor();
-    void UpdateScale();
-    void UpdatePosition(GLfloat dt);
-    void UpdateVelocity(const std::vector<glm::vec3>& pressurePoints);
+    // Fraction of the lifetime left, 1 at birth
+    GLfloat Remaining() const;
 
     glm::vec3 m_position;
     glm::vec3 m_velocity;
-    glm::vec3 m_acceleration;
-    glm::vec4 m_color;
-    GLfloat m_fLife;
-    GLfloat m_fScale;
-
-    // not-const to help compiler generate default constructor
-    GLfloat m_fInitialLife;
-    GLfloat m_fInitialScale;
+    // 0 at birth, MAX_AGE once dead
+    uint16_t m_age;
+    uint16_t m_lifeMs;
+    // initial scale as half float
+    uint16_t m_scale;
+    GLubyte m_color;
+    // sprite layer in the emitter's texture array
+    GLubyte m_layer;
 };
+
+static_assert(sizeof(Particle) == 32, "particle records must stay compact");
@@ -0,0 +1,82 @@
+#include "particle_commands.h"
+
+ParticleCommandQueue::ParticleCommandQueue(size_t capacity)
+    : m_queue(capacity),
+      m_nOverflows(0),
+      m_nApplied(0),
+      m_nOverflowsReset(0),
+      m_latencySumMs(0.0),
+      m_maxLatencyMs(0.0)
+{
+}
+
+int64_t ParticleCommandQueue::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+bool ParticleCommandQueue::Push(ParticleCommand command)
+{
+    command.enqueuedNs = Now();
+    if (!m_queue.TryPush(command)) {
+        m_nOverflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool ParticleCommandQueue::Ignite(GLuint fire, const glm::vec3& position, GLuint particlesPerFrame)
+{
+    ParticleCommand command;
+    command.type = ParticleCommand::Type::ignite;
+    command.fire = fire;
+    command.position = position;
+    command.count = particlesPerFrame;
+    return Push(command);
+}
+
+bool ParticleCommandQueue::Burst(GLuint fire, GLuint nParticles)
+{
+    ParticleCommand command;
+    command.type = ParticleCommand::Type::burst;
+    command.fire = fire;
+    command.count = nParticles;
+    return Push(command);
+}
+
+bool ParticleCommandQueue::Move(GLuint fire, const glm::vec3& position)
+{
+    ParticleCommand command;
+    command.type = ParticleCommand::Type::move;
+    command.fire = fire;
+    command.position = position;
+    return Push(command);
+}
+
+bool ParticleCommandQueue::Extinguish(GLuint fire)
+{
+    ParticleCommand command;
+    command.type = ParticleCommand::Type::extinguish;
+    command.fire = fire;
+    return Push(command);
+}
+
+ParticleCommandStats ParticleCommandQueue::GetStats() const
+{
+    ParticleCommandStats stats;
+    stats.nApplied = m_nApplied;
+    stats.nOverflows = m_nOverflows.load(std::memory_order_relaxed) - m_nOverflowsReset;
+    stats.meanLatencyMs = m_nApplied > 0 ? m_latencySumMs / m_nApplied : 0.0;
+    stats.maxLatencyMs = m_maxLatencyMs;
+    return stats;
+}
+
+void ParticleCommandQueue::ResetStats()
+{
+    m_nApplied = 0;
+    m_nOverflowsReset = m_nOverflows.load(std::memory_order_relaxed);
+    m_latencySumMs = 0.0;
+    m_maxLatencyMs = 0.0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+#include "command_queue.h"
+
+// Request from outside of the frame loop. Fires are named by an id the
+// producer picks, ignite creates the fire under that id
+struct ParticleCommand {
+    enum class Type : uint8_t { ignite, burst, move, extinguish };
+
+    Type type = Type::ignite;
+    GLuint fire = 0;
+    // ignite and move: world position
+    glm::vec3 position = glm::vec3(0.0f);
+    // ignite: particles per frame, burst: particles once
+    GLuint count = 0;
+    // steady clock at enqueue, for the latency
+    int64_t enqueuedNs = 0;
+};
+
+// Counters since the last ResetStats
+struct ParticleCommandStats {
+    size_t nApplied = 0;
+    // commands rejected because the queue was full
+    size_t nOverflows = 0;
+    // time from enqueue to drain
+    double meanLatencyMs = 0.0;
+    double maxLatencyMs = 0.0;
+};
+
+// Lock-free command queue into the particle system. Gameplay and script
+// threads enqueue without ever blocking the frame; the frame drains a
+// bounded batch per step before the emitters update
+class ParticleCommandQueue {
+public:
+    explicit ParticleCommandQueue(size_t capacity = 4096);
+
+    // Any thread. False if the queue was full, the command is dropped and
+    // counted as overflow
+    bool Ignite(GLuint fire, const glm::vec3& position, GLuint particlesPerFrame);
+    bool Burst(GLuint fire, GLuint nParticles);
+    bool Move(GLuint fire, const glm::vec3& position);
+    bool Extinguish(GLuint fire);
+
+    // Consumer only. Calls apply(command) for up to maxCommands commands
+    // in enqueue order per producer, returns how many
+    template <typename F>
+    size_t Drain(size_t maxCommands, F&& apply)
+    {
+        const int64_t now = Now();
+        ParticleCommand command;
+        size_t n = 0;
+        while (n < maxCommands && m_queue.TryPop(command)) {
+            apply(command);
+            const double latencyMs = (now - command.enqueuedNs) * 1e-6;
+            m_latencySumMs += latencyMs;
+            m_maxLatencyMs = latencyMs > m_maxLatencyMs ? latencyMs : m_maxLatencyMs;
+            ++n;
+        }
+        m_nApplied += n;
+        return n;
+    }
+
+    // Consumer only
+    ParticleCommandStats GetStats() const;
+    void ResetStats();
+
+private:
+    bool Push(ParticleCommand command);
+    static int64_t Now();
+
+    MpscQueue<ParticleCommand> m_queue;
+    std::atomic<size_t> m_nOverflows;
+
+    // consumer side
+    size_t m_nApplied;
+    size_t m_nOverflowsReset;
+    double m_latencySumMs;
+    double m_maxLatencyMs;
+};
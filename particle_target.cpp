@@ -0,0 +1,113 @@
+#include "particle_target.h"
+
+#include <algorithm>
+#include <iostream>
+
+ParticleTarget::ParticleTarget()
+    : m_divisor(1),
+      m_screenWidth(0),
+      m_screenHeight(0),
+      m_width(0),
+      m_height(0),
+      m_FBO(0),
+      m_texture(0),
+      m_VAO(0)
+{
+}
+
+ParticleTarget::~ParticleTarget()
+{
+    Release();
+    if (m_VAO != 0) {
+        glDeleteVertexArrays(1, &m_VAO);
+    }
+}
+
+void ParticleTarget::Init(const Shader& composite)
+{
+    m_composite = composite;
+    m_composite.Use().SetInteger("particles", 0);
+    glCreateVertexArrays(1, &m_VAO);
+}
+
+void ParticleTarget::SetDivisor(GLuint divisor)
+{
+    m_divisor = divisor >= 4 ? 4 : divisor >= 2 ? 2 : 1;
+}
+
+void ParticleTarget::Begin(GLuint width, GLuint height)
+{
+    m_screenWidth = width;
+    m_screenHeight = height;
+    if (m_divisor == 1) {
+        return;
+    }
+    const GLuint targetWidth = std::max(width / m_divisor, 1u);
+    const GLuint targetHeight = std::max(height / m_divisor, 1u);
+    if (targetWidth != m_width || targetHeight != m_height || m_FBO == 0) {
+        m_width = targetWidth;
+        m_height = targetHeight;
+        Allocate();
+        // fell back to the screen, End leaves it alone as well
+        if (m_FBO == 0) {
+            return;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_FBO);
+    glViewport(0, 0, m_width, m_height);
+    const GLfloat black[] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glClearNamedFramebufferfv(m_FBO, GL_COLOR, 0, black);
+}
+
+void ParticleTarget::End()
+{
+    if (m_divisor == 1) {
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, m_screenWidth, m_screenHeight);
+
+    // The target holds the sum of the particles already, add it as is
+    glBlendFunc(GL_ONE, GL_ONE);
+    m_composite.Use();
+    glBindTextureUnit(0, m_texture);
+    glBindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void ParticleTarget::Allocate()
+{
+    Release();
+
+    // 16 bit float, the palette goes brighter than white
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_texture);
+    glTextureStorage2D(m_texture, 1, GL_RGBA16F, m_width, m_height);
+    glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glCreateFramebuffers(1, &m_FBO);
+    glNamedFramebufferTexture(m_FBO, GL_COLOR_ATTACHMENT0, m_texture, 0);
+    if (glCheckNamedFramebufferStatus(m_FBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "ERROR::PARTICLE_TARGET: Framebuffer not complete at " << m_width << "x"
+                  << m_height << ", drawing at full resolution" << std::endl;
+        Release();
+        m_divisor = 1;
+    }
+}
+
+void ParticleTarget::Release()
+{
+    if (m_FBO != 0) {
+        glDeleteFramebuffers(1, &m_FBO);
+        m_FBO = 0;
+    }
+    if (m_texture != 0) {
+        glDeleteTextures(1, &m_texture);
+        m_texture = 0;
+    }
+}
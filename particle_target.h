@@ -0,0 +1,49 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "shader.h"
+
+// Offscreen target for the particle pass at a fraction of the screen
+// resolution. Additive particles are fill-rate bound and soft, so they are
+// drawn into a smaller RGBA16F texture and added onto the screen with a
+// bilinear upsample. A divisor of 1 draws straight to the screen
+class ParticleTarget {
+public:
+    // No GL calls here, Game is constructed before the context exists
+    ParticleTarget();
+    ~ParticleTarget();
+
+    ParticleTarget(const ParticleTarget&) = delete;
+    ParticleTarget& operator=(const ParticleTarget&) = delete;
+
+    // composite draws a fullscreen triangle sampling unit 0
+    void Init(const Shader& composite);
+    // 1, 2 or 4: full, half or quarter resolution per axis
+    void SetDivisor(GLuint divisor);
+    GLuint GetDivisor() const { return m_divisor; }
+
+    // Redirects drawing into the offscreen target and clears it, the
+    // screen is width x height
+    void Begin(GLuint width, GLuint height);
+    // Back to the screen and adds the particles onto it
+    void End();
+
+private:
+    // (Re)creates the texture and framebuffer for the current size
+    void Allocate();
+    void Release();
+
+    Shader m_composite;
+    GLuint m_divisor;
+    // screen and target sizes in pixels
+    GLuint m_screenWidth;
+    GLuint m_screenHeight;
+    GLuint m_width;
+    GLuint m_height;
+
+    GLuint m_FBO;
+    GLuint m_texture;
+    // attribute-less, the vertex shader makes up the triangle
+    GLuint m_VAO;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). The output is a pure function of a
+// 128-bit counter and a 64-bit key, so any thread can produce any part of
+// a stream without touching shared state.
+class Philox {
+public:
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    static constexpr Counter Generate(Counter counter, Key key)
+    {
+        for (int round = 0; round < ROUNDS; ++round) {
+            const uint64_t product0 = static_cast<uint64_t>(M0) * counter[0];
+            const uint64_t product1 = static_cast<uint64_t>(M1) * counter[2];
+            counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                       static_cast<uint32_t>(product1),
+                       static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                       static_cast<uint32_t>(product0)};
+            key[0] += W0;
+            key[1] += W1;
+        }
+        return counter;
+    }
+
+private:
+    static constexpr int ROUNDS = 10;
+    static constexpr uint32_t M0 = 0xD2511F53;
+    static constexpr uint32_t M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9;
+    static constexpr uint32_t W1 = 0xBB67AE85;
+};
+
+// Known answers of the Random123 reference implementation (kat_vectors),
+// checked by the compiler
+constexpr bool PhiloxMatches(const Philox::Counter& counter, const Philox::Key& key,
+                             const Philox::Counter& expected)
+{
+    const Philox::Counter result = Philox::Generate(counter, key);
+    return result[0] == expected[0] && result[1] == expected[1] && result[2] == expected[2] &&
+           result[3] == expected[3];
+}
+static_assert(PhiloxMatches({0, 0, 0, 0}, {0, 0},
+                            {0x6627E8D5, 0xE169C58D, 0xBC57AC4C, 0x9B00DBD8}),
+              "Philox4x32-10 differs from the reference");
+static_assert(PhiloxMatches({0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}, {0xFFFFFFFF, 0xFFFFFFFF},
+                            {0x408F276D, 0x41C83B0E, 0xA20BC7C6, 0x6D5451FD}),
+              "Philox4x32-10 differs from the reference");
+static_assert(PhiloxMatches({0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344}, {0xA4093822, 0x299F31D0},
+                            {0xD16CFE09, 0x94FDCCEB, 0x5001E420, 0x24126EA1}),
+              "Philox4x32-10 differs from the reference");
+
+// Random numbers of one particle, keyed by the emitter seed and counted
+// by frame, ring slot and channel. Separate channels give independent
+// streams for the same particle, e.g. its position and its attributes.
+// The same arguments yield the same numbers on any thread
+class ParticleRandom {
+public:
+    ParticleRandom(uint64_t seed, uint32_t frame, uint32_t slot, uint32_t channel = 0)
+        : m_counter{slot, frame, channel, 0},
+          m_key{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)},
+          m_block{},
+          m_next(4)
+    {
+    }
+
+    uint32_t NextUInt()
+    {
+        if (m_next == 4) {
+            m_block = Philox::Generate(m_counter, m_key);
+            ++m_counter[3];
+            m_next = 0;
+        }
+        return m_block[m_next++];
+    }
+
+    // [0, 1), 24 bits so every value is exact in a float
+    float Uniform() { return (NextUInt() >> 8) * (1.0f / 16777216.0f); }
+
+    float Uniform(float low, float high) { return low + (high - low) * Uniform(); }
+
+    // [0, n), n must not be 0
+    uint32_t Below(uint32_t n) { return static_cast<uint32_t>((static_cast<uint64_t>(NextUInt()) * n) >> 32); }
+
+    // Box-Muller, one normal per pair of uniforms
+    float Normal(float mean, float deviation)
+    {
+        const float u = 1.0f - Uniform();
+        const float v = Uniform();
+        return mean + deviation * std::sqrt(-2.0f * std::log(u)) * std::cos(6.2831853f * v);
+    }
+
+private:
+    Philox::Counter m_counter;
+    Philox::Key m_key;
+    Philox::Counter m_block;
+    int m_next;
+};
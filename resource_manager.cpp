@@ -8,16 +8,22 @@
 ******************************************************************/
 #include "resource_manager.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 
+#include "thread_pool.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 // Instantiate static variables
 std::map<std::string, Texture2D>    ResourceManager::Textures;
+std::map<std::string, Texture2DArray> ResourceManager::TextureArrays;
 std::map<std::string, Shader>       ResourceManager::Shaders;
+std::vector<ResourceManager::PendingTexture> ResourceManager::PendingTextures;
 
 
 Shader& ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, const std::string& name)
@@ -37,19 +43,113 @@ Texture2D& ResourceManager::LoadTexture(const GLchar *file, GLboolean alpha, con
     return Textures[name];
 }
 
+Texture2D& ResourceManager::LoadTextureAsync(const GLchar *file, GLboolean alpha, const std::string& name)
+{
+    Texture2D texture;
+    if (alpha)
+    {
+        texture.Internal_Format = GL_RGBA;
+        texture.Image_Format = GL_RGBA;
+    }
+    // Keep rendering with a white texel until the real image arrives
+    const unsigned char white[4] = {255, 255, 255, 255};
+    texture.Generate(1, 1, white);
+    Textures[name] = texture;
+
+    PendingTextures.push_back(queueDecode({file}, alpha, name, GL_FALSE, 0));
+    return Textures[name];
+}
+
+size_t ResourceManager::UploadPendingTextures(GLboolean wait)
+{
+    auto ready = [wait](PendingTexture& pending) {
+        for (auto& layer : pending.Decoded) {
+            if (wait)
+                layer.wait();
+            if (layer.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return false;
+        }
+        return true;
+    };
+
+    for (auto iter = PendingTextures.begin(); iter != PendingTextures.end();)
+    {
+        if (!ready(*iter)) {
+            ++iter;
+            continue;
+        }
+        std::vector<Image> images;
+        GLboolean failed = GL_FALSE;
+        for (size_t i = 0; i < iter->Decoded.size(); ++i) {
+            images.push_back(iter->Decoded[i].get());
+            if (!images.back().Data) {
+                std::cout << "Failed to load texture at path: " << iter->Files[i] << std::endl;
+                failed = GL_TRUE;
+            }
+        }
+        // A broken layer leaves the whole texture at its placeholder
+        if (!failed) {
+            if (iter->Array)
+                uploadLayers(TextureArrays[iter->Name], images);
+            else
+                uploadImage(Textures[iter->Name], images.front());
+        }
+        iter = PendingTextures.erase(iter);
+    }
+    return PendingTextures.size();
+}
+
 Texture2D& ResourceManager::GetTexture(const std::string& name)
 {
     return Textures[name];
 }
 
+Texture2DArray& ResourceManager::LoadTextureArray(const std::vector<std::string>& files, GLboolean alpha, const std::string& name, GLuint layerSize)
+{
+    LoadTextureArrayAsync(files, alpha, name, layerSize);
+    // Layers still decode in parallel, we just wait for all of them
+    for (auto& layer : PendingTextures.back().Decoded)
+        layer.wait();
+    UploadPendingTextures();
+    return TextureArrays[name];
+}
+
+Texture2DArray& ResourceManager::LoadTextureArrayAsync(const std::vector<std::string>& files, GLboolean alpha, const std::string& name, GLuint layerSize)
+{
+    Texture2DArray texture;
+    if (alpha)
+    {
+        texture.Internal_Format = GL_RGBA;
+        texture.Image_Format = GL_RGBA;
+    }
+    // White 1x1 layers keep the layer count valid for early draws
+    const std::vector<unsigned char> white(4 * files.size(), 255);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    texture.Generate(1, 1, files.size(), white.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    TextureArrays[name] = texture;
+
+    PendingTextures.push_back(queueDecode(files, alpha, name, GL_TRUE, layerSize));
+    return TextureArrays[name];
+}
+
+Texture2DArray& ResourceManager::GetTextureArray(const std::string& name)
+{
+    return TextureArrays[name];
+}
+
 void ResourceManager::Clear()
 {
+    // Outstanding decodes are simply dropped
+    PendingTextures.clear();
     // (Properly) delete all shaders
     for (const auto& iter : Shaders)
         glDeleteProgram(iter.second.ID);
     // (Properly) delete all textures
     for (const auto& iter : Textures)
         glDeleteTextures(1, &iter.second.ID);
+    for (const auto& iter : TextureArrays)
+        glDeleteTextures(1, &iter.second.ID);
 }
 
 Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile)
@@ -111,15 +211,111 @@ Texture2D ResourceManager::loadTextureFromFile(const GLchar *file, GLboolean alp
         texture.Image_Format = GL_RGBA;
     }
     // Load image
-    int width, height, nChannels;
-    unsigned char* image = stbi_load(file, &width, &height, &nChannels, 0);
-    if (image) {
+    const Image image = decodeImage(file, alpha);
+    if (image.Data) {
         // Now generate texture
-        texture.Generate(width, height, image);
+        texture.Generate(image.Width, image.Height, image.Data.get());
     } else {
         std::cout << "Failed to load texture at path: " << file << std::endl;
     }
-    // And finally free image data
-    stbi_image_free(image);
     return texture;
 }
+
+ResourceManager::Image ResourceManager::decodeImage(const std::string& file, GLboolean alpha, GLuint size)
+{
+    Image image;
+    // Force the channel count to match the texture's image format
+    const int nChannels = alpha ? 4 : 3;
+    image.Data.reset(stbi_load(file.c_str(), &image.Width, &image.Height, &image.Channels, nChannels));
+    image.Data.get_deleter() = stbi_image_free;
+    image.Channels = nChannels;
+    if (image.Data && size != 0 &&
+        (static_cast<GLuint>(image.Width) != size || static_cast<GLuint>(image.Height) != size))
+        return resampleImage(image, size);
+    return image;
+}
+
+ResourceManager::Image ResourceManager::resampleImage(const Image& image, GLuint size)
+{
+    Image result;
+    result.Width = size;
+    result.Height = size;
+    result.Channels = image.Channels;
+    result.Data.reset(static_cast<unsigned char*>(malloc(size * size * image.Channels)));
+
+    const GLfloat scaleX = static_cast<GLfloat>(image.Width) / size;
+    const GLfloat scaleY = static_cast<GLfloat>(image.Height) / size;
+    const unsigned char* src = image.Data.get();
+    unsigned char* dst = result.Data.get();
+    for (GLuint y = 0; y < size; ++y) {
+        // sample at texel centers
+        const GLfloat fy = std::max((y + 0.5f) * scaleY - 0.5f, 0.0f);
+        const int y0 = std::min(static_cast<int>(fy), image.Height - 1);
+        const int y1 = std::min(y0 + 1, image.Height - 1);
+        const GLfloat ty = fy - y0;
+        for (GLuint x = 0; x < size; ++x) {
+            const GLfloat fx = std::max((x + 0.5f) * scaleX - 0.5f, 0.0f);
+            const int x0 = std::min(static_cast<int>(fx), image.Width - 1);
+            const int x1 = std::min(x0 + 1, image.Width - 1);
+            const GLfloat tx = fx - x0;
+            for (int c = 0; c < image.Channels; ++c) {
+                auto texel = [&](int px, int py) {
+                    return static_cast<GLfloat>(src[(py * image.Width + px) * image.Channels + c]);
+                };
+                const GLfloat top = texel(x0, y0) * (1.0f - tx) + texel(x1, y0) * tx;
+                const GLfloat bottom = texel(x0, y1) * (1.0f - tx) + texel(x1, y1) * tx;
+                dst[(y * size + x) * image.Channels + c] =
+                    static_cast<unsigned char>(top * (1.0f - ty) + bottom * ty + 0.5f);
+            }
+        }
+    }
+    return result;
+}
+
+ResourceManager::PendingTexture ResourceManager::queueDecode(const std::vector<std::string>& files, GLboolean alpha, const std::string& name, GLboolean array, GLuint size)
+{
+    PendingTexture pending{name, files, {}, array};
+    // One job per file, so layers decode concurrently
+    for (const auto& file : files) {
+        pending.Decoded.push_back(ThreadPool::Instance().Enqueue(
+            [file, alpha, size]() { return decodeImage(file, alpha, size); }));
+    }
+    return pending;
+}
+
+void ResourceManager::uploadImage(Texture2D& texture, const Image& image)
+{
+    const GLsizeiptr size = static_cast<GLsizeiptr>(image.Width) * image.Height * image.Channels;
+
+    // The driver copies from the PBO asynchronously, so glTexImage2D
+    // returns without waiting for the transfer
+    GLuint pbo;
+    glCreateBuffers(1, &pbo);
+    glNamedBufferData(pbo, size, image.Data.get(), GL_STREAM_DRAW);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    texture.Generate(image.Width, image.Height, nullptr);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    // Deletion is deferred by GL until the upload has consumed the buffer
+    glDeleteBuffers(1, &pbo);
+}
+
+void ResourceManager::uploadLayers(Texture2DArray& texture, const std::vector<Image>& layers)
+{
+    const Image& first = layers.front();
+    const GLsizeiptr layerSize = static_cast<GLsizeiptr>(first.Width) * first.Height * first.Channels;
+
+    GLuint pbo;
+    glCreateBuffers(1, &pbo);
+    glNamedBufferData(pbo, layerSize * layers.size(), nullptr, GL_STREAM_DRAW);
+    for (size_t i = 0; i < layers.size(); ++i)
+        glNamedBufferSubData(pbo, layerSize * i, layerSize, layers[i].Data.get());
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    texture.Generate(first.Width, first.Height, layers.size(), nullptr);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(1, &pbo);
+}
@@ -8,8 +8,12 @@
 ******************************************************************/
 #pragma once
 
+#include <cstdlib>
+#include <future>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <GL/glew.h>
 
@@ -28,22 +32,63 @@ public:
     // Resource storage
     static std::map<std::string, Shader>    Shaders;
     static std::map<std::string, Texture2D> Textures;
+    static std::map<std::string, Texture2DArray> TextureArrays;
     // Loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader
     static Shader&   LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, const std::string& name);
     // Retrieves a stored sader
     static Shader&   GetShader(const std::string& name);
     // Loads (and generates) a texture from file
     static Texture2D& LoadTexture(const GLchar *file, GLboolean alpha, const std::string& name);
+    // Queues decoding of a texture on the worker pool. Returns a 1x1 white
+    // placeholder which is filled in by UploadPendingTextures() once ready
+    static Texture2D& LoadTextureAsync(const GLchar *file, GLboolean alpha, const std::string& name);
+    // Uploads all decoded textures (GL thread only). If wait is set, blocks
+    // until every queued texture is uploaded. Returns the number still pending
+    static size_t    UploadPendingTextures(GLboolean wait = GL_FALSE);
     // Retrieves a stored texture
     static Texture2D& GetTexture(const std::string& name);
+    // Loads a texture array, one layer per file. Every image is resampled to
+    // layerSize x layerSize so that sprites of different size can share it
+    static Texture2DArray& LoadTextureArray(const std::vector<std::string>& files, GLboolean alpha, const std::string& name, GLuint layerSize = 512);
+    // Same as LoadTextureArray(), but decodes on the worker pool and returns
+    // a white placeholder with the final layer count
+    static Texture2DArray& LoadTextureArrayAsync(const std::vector<std::string>& files, GLboolean alpha, const std::string& name, GLuint layerSize = 512);
+    // Retrieves a stored texture array
+    static Texture2DArray& GetTextureArray(const std::string& name);
     // Properly de-allocates all loaded resources
     static void      Clear();
 
 private:
+    // Decoded image data, owned by stb_image
+    struct Image {
+        int Width = 0, Height = 0, Channels = 0;
+        std::unique_ptr<unsigned char, void (*)(void*)> Data{nullptr, free};
+    };
+    // Texture waiting for its images to be decoded by workers
+    struct PendingTexture {
+        std::string Name;
+        std::vector<std::string> Files;
+        // one image per layer, a plain Texture2D has a single one
+        std::vector<std::future<Image>> Decoded;
+        GLboolean Array;
+    };
+    static std::vector<PendingTexture> PendingTextures;
+
     // Private constructor, that is we do not want any actual resource manager objects. Its members and functions should be publicly available (static).
     ResourceManager() { }
     // Loads and generates a shader from file
     static Shader    loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile = nullptr);
     // Loads a single texture from file
     static Texture2D loadTextureFromFile(const GLchar *file, GLboolean alpha);
+    // Decodes an image, safe to call from any thread. A non-zero size
+    // resamples it to size x size
+    static Image     decodeImage(const std::string& file, GLboolean alpha, GLuint size = 0);
+    // Bilinearly resamples an image to size x size
+    static Image     resampleImage(const Image& image, GLuint size);
+    // Queues decoding of every file on the worker pool
+    static PendingTexture queueDecode(const std::vector<std::string>& files, GLboolean alpha, const std::string& name, GLboolean array, GLuint size);
+    // Streams decoded image into the texture through a pixel unpack buffer
+    static void      uploadImage(Texture2D& texture, const Image& image);
+    // Streams decoded layers into the texture array, then builds its mipmaps
+    static void      uploadLayers(Texture2DArray& texture, const std::vector<Image>& layers);
 };
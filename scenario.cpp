@@ -0,0 +1,253 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+#include "curl_noise.h"
+#include "emitter.h"
+#include "fluid_grid.h"
+
+namespace {
+
+bool ParseEffect(const std::string& name, EmitterEffect& effect)
+{
+    if (name == "fire")
+        effect = EmitterEffect::fire;
+    else if (name == "sparks")
+        effect = EmitterEffect::sparks;
+    else if (name == "embers")
+        effect = EmitterEffect::embers;
+    else
+        return false;
+    return true;
+}
+
+bool ParseEmitter(std::istringstream& tokens, EmitterSpec& spec)
+{
+    std::string effect;
+    if (!(tokens >> effect) || !ParseEffect(effect, spec.effect)) {
+        return false;
+    }
+    std::string key;
+    while (tokens >> key) {
+        if (key == "position")
+            tokens >> spec.position.x >> spec.position.y >> spec.position.z;
+        else if (key == "direction")
+            tokens >> spec.direction.x >> spec.direction.y >> spec.direction.z;
+        else if (key == "radius")
+            tokens >> spec.radius;
+        else if (key == "velocity")
+            tokens >> spec.velocity;
+        else if (key == "amount")
+            tokens >> spec.amount;
+        else if (key == "rate")
+            tokens >> spec.rate;
+        else if (key == "start")
+            tokens >> spec.start;
+        else if (key == "energy")
+            tokens >> spec.energy;
+        else if (key == "interaction")
+            tokens >> spec.interaction;
+        else
+            return false;
+        if (!tokens) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool Scenario::Load(const std::string& file, Scenario& scenario)
+{
+    std::ifstream stream(file);
+    if (!stream) {
+        std::cout << "Failed to load scenario at path: " << file << std::endl;
+        return false;
+    }
+
+    scenario = Scenario();
+    const size_t slash = file.find_last_of('/');
+    const std::string base = slash == std::string::npos ? file : file.substr(slash + 1);
+    scenario.name = base.substr(0, base.find_last_of('.'));
+
+    std::string line;
+    for (size_t nLine = 1; std::getline(stream, line); ++nLine) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string keyword;
+        if (!(tokens >> keyword)) {
+            continue;
+        }
+
+        bool ok = true;
+        if (keyword == "name") {
+            ok = static_cast<bool>(tokens >> scenario.name);
+        } else if (keyword == "duration") {
+            ok = static_cast<bool>(tokens >> scenario.duration);
+        } else if (keyword == "dt") {
+            ok = static_cast<bool>(tokens >> scenario.dt) && scenario.dt > 0.0f;
+        } else if (keyword == "warmup") {
+            ok = static_cast<bool>(tokens >> scenario.warmup);
+        } else if (keyword == "seed") {
+            ok = static_cast<bool>(tokens >> scenario.seed);
+        } else if (keyword == "fluid") {
+            ok = static_cast<bool>(tokens >> scenario.fluidResolution.x >> scenario.fluidResolution.y >>
+                                   scenario.fluidResolution.z >> scenario.fluidCellSize);
+        } else if (keyword == "turbulence") {
+            ok = static_cast<bool>(tokens >> scenario.turbulenceAmplitude >> scenario.turbulenceFrequency);
+        } else if (keyword == "sample") {
+            ok = static_cast<bool>(tokens >> scenario.sample) && scenario.sample >= 0.0f;
+        } else if (keyword == "emitter") {
+            EmitterSpec spec;
+            ok = ParseEmitter(tokens, spec);
+            scenario.emitters.push_back(spec);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cout << "ERROR::SCENARIO: " << file << ":" << nLine << ": invalid line: " << line
+                      << std::endl;
+            return false;
+        }
+    }
+
+    if (scenario.emitters.empty()) {
+        std::cout << "ERROR::SCENARIO: " << file << ": no emitters" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+// 95th percentile height of the live particles above their emitters
+GLfloat PlumeHeight(const std::vector<std::unique_ptr<Emitter>>& emitters,
+                    const std::vector<EmitterSpec>& specs)
+{
+    std::vector<glm::vec3> offsets;
+    std::vector<glm::vec4> colors;
+    std::vector<GLfloat> scales;
+    std::vector<GLuint> layers;
+    std::vector<GLfloat> heights;
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        if (!emitters[i]) {
+            continue;
+        }
+        offsets.resize(specs[i].amount);
+        colors.resize(specs[i].amount);
+        scales.resize(specs[i].amount);
+        layers.resize(specs[i].amount);
+        const size_t n = emitters[i]->Export(offsets.data(), colors.data(), scales.data(),
+                                             layers.data(), specs[i].amount);
+        for (size_t j = 0; j < n; ++j) {
+            // dead ones inside the live window have no scale
+            if (scales[j] > 0.0f) {
+                heights.push_back(offsets[j].y);
+            }
+        }
+    }
+    if (heights.empty()) {
+        return 0.0f;
+    }
+    const size_t p95 = std::min(heights.size() * 95 / 100, heights.size() - 1);
+    std::nth_element(heights.begin(), heights.begin() + p95, heights.end());
+    return heights[p95];
+}
+
+} // namespace
+
+ScenarioResult RunScenario(const Scenario& scenario)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // same placement as the game: the first emitter at the bottom center
+    const glm::vec3 fluidSize = glm::vec3(scenario.fluidResolution) * scenario.fluidCellSize;
+    FluidGrid fluid(scenario.fluidResolution, scenario.fluidCellSize,
+                    scenario.emitters.front().position -
+                        glm::vec3(fluidSize.x / 2, 2.0f, fluidSize.z / 2));
+    std::unique_ptr<CurlNoise> noise;
+    if (scenario.turbulenceAmplitude > 0.0f) {
+        CurlNoiseParams params;
+        params.seed = scenario.seed;
+        noise.reset(new CurlNoise(params));
+    }
+    std::vector<std::unique_ptr<Emitter>> emitters(scenario.emitters.size());
+    const size_t nSteps = static_cast<size_t>(scenario.duration / scenario.dt + 0.5f);
+    const size_t nWarmup = std::min(static_cast<size_t>(scenario.warmup / scenario.dt + 0.5f), nSteps);
+    std::vector<double> stepMs;
+    stepMs.reserve(nSteps);
+    size_t nParticleSteps = 0;
+    double totalSeconds = 0.0;
+    ScenarioResult result;
+    result.name = scenario.name;
+    // steps between trace samples, 0 for none
+    size_t sampleSteps = 0;
+    if (scenario.sample > 0.0f) {
+        sampleSteps = std::max<size_t>(static_cast<size_t>(scenario.sample / scenario.dt + 0.5f), 1);
+    }
+
+    for (size_t step = 0; step < nSteps; ++step) {
+        const GLfloat time = step * scenario.dt;
+        // created outside of the timed region, allocation is not the load
+        for (size_t i = 0; i < emitters.size(); ++i) {
+            const EmitterSpec& spec = scenario.emitters[i];
+            if (!emitters[i] && time >= spec.start) {
+                // no GL context here, scenarios run on any thread
+                emitters[i].reset(new Emitter(Shader(), Texture2DArray(0), spec.position,
+                                              spec.direction, spec.radius, spec.energy,
+                                              spec.velocity, spec.amount, EmitterMode::headless,
+                                              spec.effect));
+                emitters[i]->SetSeed((static_cast<uint64_t>(scenario.seed) << 32) | i);
+                if (noise) {
+                    emitters[i]->SetTurbulence(noise.get(), scenario.turbulenceAmplitude,
+                                               scenario.turbulenceFrequency);
+                }
+                if (spec.interaction > 0.0f) {
+                    ParticleInteraction interaction;
+                    interaction.radius = spec.interaction;
+                    emitters[i]->SetInteraction(interaction);
+                }
+            }
+        }
+
+        const Clock::time_point begin = Clock::now();
+        fluid.Step(scenario.dt);
+        size_t nParticles = 0;
+        for (size_t i = 0; i < emitters.size(); ++i) {
+            if (emitters[i]) {
+                emitters[i]->Update(scenario.dt, scenario.emitters[i].rate, fluid);
+                emitters[i]->AddHeat(fluid, scenario.dt);
+                nParticles += emitters[i]->GetParticleCount();
+            }
+        }
+        const double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        if (step >= nWarmup) {
+            stepMs.push_back(seconds * 1000.0);
+            nParticleSteps += nParticles;
+            totalSeconds += seconds;
+        }
+        if (sampleSteps > 0 && (step + 1) % sampleSteps == 0) {
+            result.liveCounts.push_back(nParticles);
+            result.plumeHeights.push_back(PlumeHeight(emitters, scenario.emitters));
+            result.peakPlumeHeight = std::max(result.peakPlumeHeight, result.plumeHeights.back());
+        }
+        result.finalParticles = nParticles;
+    }
+
+    result.nSteps = stepMs.size();
+    if (!stepMs.empty()) {
+        result.throughput = totalSeconds > 0.0 ? nParticleSteps / totalSeconds : 0.0;
+        result.meanStepMs = totalSeconds * 1000.0 / stepMs.size();
+        const size_t p99 = std::min(stepMs.size() * 99 / 100, stepMs.size() - 1);
+        std::nth_element(stepMs.begin(), stepMs.begin() + p99, stepMs.end());
+        result.p99StepMs = stepMs[p99];
+    }
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "emitter_kernel.h"
+
+// One emitter of a scenario
+struct EmitterSpec {
+    EmitterEffect effect = EmitterEffect::fire;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 1.0f, 0.0f);
+    GLfloat radius = 3.0f;
+    GLfloat velocity = 7.0f;
+    GLuint amount = 5000;
+    // particles spawned per step
+    GLuint rate = 300;
+    // seconds into the scenario the emitter appears
+    GLfloat start = 0.0f;
+    // seconds it keeps emitting
+    GLfloat energy = 500.0f;
+    // neighbour radius of particle interactions, 0 disables them
+    GLfloat interaction = 0.0f;
+};
+
+// Reproducible load profile for the headless benchmark. Text format, one
+// setting per line, '#' starts a comment:
+//
+//   name        burst_100k
+//   duration    10              seconds simulated
+//   dt          0.0166667       fixed step
+//   warmup      0.5             seconds left out of the statistics
+//   seed        1
+//   fluid       32 64 32 0.5    resolution and cell size
+//   turbulence  1.5 0.15        amplitude and frequency, 0 disables
+//   sample      0.25            seconds between trace samples, 0 (the
+//                               default) records no trace
+//   emitter     fire position 20 0 0 amount 100000 rate 2000 ...
+//
+// Emitter lines take the effect (fire, sparks, embers) followed by
+// key/value pairs named after the EmitterSpec fields; vectors take three
+// values. The fluid volume is centered under the first emitter
+struct Scenario {
+    std::string name;
+    GLfloat duration = 10.0f;
+    GLfloat dt = 1.0f / 60.0f;
+    GLfloat warmup = 0.5f;
+    unsigned seed = 1;
+    glm::ivec3 fluidResolution = glm::ivec3(32, 64, 32);
+    GLfloat fluidCellSize = 0.5f;
+    GLfloat turbulenceAmplitude = 0.0f;
+    GLfloat turbulenceFrequency = 0.15f;
+    GLfloat sample = 0.0f;
+    std::vector<EmitterSpec> emitters;
+
+    // Parses a scenario file, prints the problem and returns false on
+    // errors. The name defaults to the file name
+    static bool Load(const std::string& file, Scenario& scenario);
+};
+
+struct ScenarioResult {
+    std::string name;
+    size_t nSteps = 0;
+    // particle updates per second of wall time
+    double throughput = 0.0;
+    double meanStepMs = 0.0;
+    double p99StepMs = 0.0;
+
+    // Trace, sampled every Scenario::sample seconds outside of the
+    // timed region. Live particles of all emitters and the plume height:
+    // the 95th percentile of the live particles' heights above their
+    // emitter
+    std::vector<size_t> liveCounts;
+    std::vector<GLfloat> plumeHeights;
+    GLfloat peakPlumeHeight = 0.0f;
+    size_t finalParticles = 0;
+};
+
+// Plays a scenario without a GL context as fast as possible, timing
+// every step of the fluid and all emitters
+ScenarioResult RunScenario(const Scenario& scenario);
@@ -0,0 +1,391 @@
+#include "sdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+
+#include "thread_pool.h"
+
+#define SDF_MAGIC 0x32464453u // "SDF2", pseudo normal signs
+
+namespace {
+
+// Part of a triangle a closest point lies on
+enum class TriangleFeature { a, b, c, ab, ac, bc, face };
+
+// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection)
+glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a,
+                                 const glm::vec3& b, const glm::vec3& c,
+                                 TriangleFeature& feature)
+{
+    const glm::vec3 ab = b - a;
+    const glm::vec3 ac = c - a;
+    const glm::vec3 ap = p - a;
+    const GLfloat d1 = glm::dot(ab, ap);
+    const GLfloat d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) {
+        feature = TriangleFeature::a;
+        return a;
+    }
+
+    const glm::vec3 bp = p - b;
+    const GLfloat d3 = glm::dot(ab, bp);
+    const GLfloat d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) {
+        feature = TriangleFeature::b;
+        return b;
+    }
+
+    const GLfloat vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        feature = TriangleFeature::ab;
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    const glm::vec3 cp = p - c;
+    const GLfloat d5 = glm::dot(ab, cp);
+    const GLfloat d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) {
+        feature = TriangleFeature::c;
+        return c;
+    }
+
+    const GLfloat vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        feature = TriangleFeature::ac;
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    const GLfloat va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        feature = TriangleFeature::bc;
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    feature = TriangleFeature::face;
+    const GLfloat denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// Angle weighted pseudo normals (Baerentzen and Aanaes, Signed Distance
+// Computation Using the Angle Weighted Pseudonormal). The direction from
+// the closest feature to a point agrees in sign with the feature's pseudo
+// normal on closed meshes, also at edges and corners where several
+// triangles are equally close and their face normals disagree
+struct PseudoNormals {
+    std::vector<glm::vec3> faces;
+    // per triangle, the normals of its edges ab, ac and bc
+    std::vector<glm::vec3> edges;
+    std::vector<glm::vec3> vertices;
+
+    explicit PseudoNormals(const TriangleMesh& mesh)
+        : faces(mesh.Triangles.size(), glm::vec3(0.0f)),
+          edges(3 * mesh.Triangles.size(), glm::vec3(0.0f)),
+          vertices(mesh.Vertices.size(), glm::vec3(0.0f))
+    {
+        // sum of the face normals of the (usually two) triangles by edge
+        std::unordered_map<uint64_t, glm::vec3> edgeSums;
+        const auto edgeKey = [](GLuint i, GLuint j) {
+            return static_cast<uint64_t>(std::min(i, j)) << 32 | std::max(i, j);
+        };
+        for (size_t t = 0; t < mesh.Triangles.size(); ++t) {
+            const glm::uvec3& triangle = mesh.Triangles[t];
+            const GLuint corners[3] = {triangle.x, triangle.y, triangle.z};
+            const glm::vec3 normal = glm::cross(mesh.Vertices[triangle.y] - mesh.Vertices[triangle.x],
+                                                mesh.Vertices[triangle.z] - mesh.Vertices[triangle.x]);
+            const GLfloat length = glm::length(normal);
+            if (length <= 0.0f) {
+                // degenerate, no say in any pseudo normal
+                continue;
+            }
+            faces[t] = normal / length;
+            for (int i = 0; i < 3; ++i) {
+                const glm::vec3& corner = mesh.Vertices[corners[i]];
+                const glm::vec3 u = mesh.Vertices[corners[(i + 1) % 3]] - corner;
+                const glm::vec3 v = mesh.Vertices[corners[(i + 2) % 3]] - corner;
+                const GLfloat uv = glm::length(u) * glm::length(v);
+                if (uv > 0.0f) {
+                    vertices[corners[i]] += std::acos(glm::clamp(glm::dot(u, v) / uv, -1.0f, 1.0f)) * faces[t];
+                }
+                edgeSums[edgeKey(corners[i], corners[(i + 1) % 3])] += faces[t];
+            }
+        }
+        for (size_t t = 0; t < mesh.Triangles.size(); ++t) {
+            const glm::uvec3& triangle = mesh.Triangles[t];
+            edges[3 * t + 0] = edgeSums[edgeKey(triangle.x, triangle.y)];
+            edges[3 * t + 1] = edgeSums[edgeKey(triangle.x, triangle.z)];
+            edges[3 * t + 2] = edgeSums[edgeKey(triangle.y, triangle.z)];
+        }
+    }
+
+    // Pseudo normal of a feature of triangle t, unnormalized
+    glm::vec3 Get(const TriangleMesh& mesh, size_t t, TriangleFeature feature) const
+    {
+        switch (feature) {
+        case TriangleFeature::a:
+            return vertices[mesh.Triangles[t].x];
+        case TriangleFeature::b:
+            return vertices[mesh.Triangles[t].y];
+        case TriangleFeature::c:
+            return vertices[mesh.Triangles[t].z];
+        case TriangleFeature::ab:
+            return edges[3 * t + 0];
+        case TriangleFeature::ac:
+            return edges[3 * t + 1];
+        case TriangleFeature::bc:
+            return edges[3 * t + 2];
+        default:
+            return faces[t];
+        }
+    }
+};
+
+void HashBytes(uint64_t& hash, const void* data, size_t size)
+{
+    // FNV-1a
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+}
+
+} // namespace
+
+SignedDistanceField::SignedDistanceField(const TriangleMesh& mesh, GLfloat voxelSize, GLfloat band)
+    : m_key(CacheKey(mesh, voxelSize, band)),
+      m_voxelSize(voxelSize),
+      m_band(band)
+{
+    if (mesh.Empty()) {
+        return;
+    }
+
+    // 1. Bounds padded by the band, in whole bricks
+    glm::vec3 lower(std::numeric_limits<GLfloat>::max());
+    glm::vec3 upper(std::numeric_limits<GLfloat>::lowest());
+    for (const auto& vertex : mesh.Vertices) {
+        lower = glm::min(lower, vertex);
+        upper = glm::max(upper, vertex);
+    }
+    m_origin = lower - glm::vec3(band);
+    const GLfloat brickExtent = BRICK_SIZE * voxelSize;
+    const glm::vec3 extent = upper + glm::vec3(band) - m_origin;
+    m_bricks = glm::max(glm::ivec3(glm::floor(extent / brickExtent)) + 1, glm::ivec3(1));
+
+    // 2. Bin triangles into every brick their band-inflated bounds touch
+    const size_t nBricks = static_cast<size_t>(m_bricks.x) * m_bricks.y * m_bricks.z;
+    std::vector<std::vector<GLuint>> binned(nBricks);
+    for (size_t t = 0; t < mesh.Triangles.size(); ++t) {
+        const glm::uvec3& triangle = mesh.Triangles[t];
+        const glm::vec3& a = mesh.Vertices[triangle.x];
+        const glm::vec3& b = mesh.Vertices[triangle.y];
+        const glm::vec3& c = mesh.Vertices[triangle.z];
+        const glm::vec3 tLower = glm::min(a, glm::min(b, c)) - glm::vec3(band) - m_origin;
+        const glm::vec3 tUpper = glm::max(a, glm::max(b, c)) + glm::vec3(band) - m_origin;
+        const glm::ivec3 first = glm::max(glm::ivec3(glm::floor(tLower / brickExtent)), glm::ivec3(0));
+        const glm::ivec3 last = glm::min(glm::ivec3(glm::floor(tUpper / brickExtent)), m_bricks - 1);
+        for (int z = first.z; z <= last.z; ++z)
+            for (int y = first.y; y <= last.y; ++y)
+                for (int x = first.x; x <= last.x; ++x)
+                    binned[BrickIndex(x, y, z)].push_back(t);
+    }
+
+    // 3. Allocate the touched bricks only
+    const size_t brickSamples = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+    m_brickOffsets.assign(nBricks, -1);
+    std::vector<size_t> allocated;
+    for (size_t i = 0; i < nBricks; ++i) {
+        if (!binned[i].empty()) {
+            m_brickOffsets[i] = static_cast<int32_t>(allocated.size() * brickSamples);
+            allocated.push_back(i);
+        }
+    }
+    m_samples.assign(allocated.size() * brickSamples, band);
+
+    // 4. Exact distances inside the bricks, one brick per job, signed by
+    // the pseudo normal of the closest feature
+    const PseudoNormals normals(mesh);
+    ThreadPool::Instance().ParallelFor(0, allocated.size(), [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; ++n) {
+            const size_t brick = allocated[n];
+            const glm::ivec3 coord(brick % m_bricks.x, (brick / m_bricks.x) % m_bricks.y,
+                                   brick / (static_cast<size_t>(m_bricks.x) * m_bricks.y));
+            const glm::vec3 brickOrigin = m_origin + glm::vec3(coord) * brickExtent;
+            GLfloat* samples = &m_samples[m_brickOffsets[brick]];
+
+            for (int z = 0; z < BRICK_SAMPLES; ++z) {
+                for (int y = 0; y < BRICK_SAMPLES; ++y) {
+                    for (int x = 0; x < BRICK_SAMPLES; ++x) {
+                        const glm::vec3 p = brickOrigin + glm::vec3(x, y, z) * voxelSize;
+                        GLfloat best = std::numeric_limits<GLfloat>::max();
+                        glm::vec3 bestToPoint(0.0f);
+                        GLuint bestTriangle = 0;
+                        TriangleFeature bestFeature = TriangleFeature::face;
+                        for (GLuint t : binned[brick]) {
+                            const glm::uvec3& triangle = mesh.Triangles[t];
+                            TriangleFeature feature;
+                            const glm::vec3 toPoint =
+                                p - ClosestPointOnTriangle(p, mesh.Vertices[triangle.x], mesh.Vertices[triangle.y],
+                                                           mesh.Vertices[triangle.z], feature);
+                            const GLfloat distance = glm::length(toPoint);
+                            if (distance < best) {
+                                best = distance;
+                                bestToPoint = toPoint;
+                                bestTriangle = t;
+                                bestFeature = feature;
+                            }
+                        }
+                        const GLfloat sign =
+                            glm::dot(bestToPoint, normals.Get(mesh, bestTriangle, bestFeature)) < 0.0f ? -1.0f : 1.0f;
+                        samples[(z * BRICK_SAMPLES + y) * BRICK_SAMPLES + x] =
+                            std::min(best, band) * sign;
+                    }
+                }
+            }
+        }
+    });
+}
+
+std::shared_ptr<SignedDistanceField> SignedDistanceField::LoadOrBuild(const std::string& meshFile,
+                                                                      GLfloat voxelSize, GLfloat band)
+{
+    const TriangleMesh mesh = TriangleMesh::Load(meshFile);
+    if (mesh.Empty()) {
+        return nullptr;
+    }
+
+    const std::string cacheFile = meshFile + ".sdf";
+    std::shared_ptr<SignedDistanceField> field(new SignedDistanceField());
+    if (field->Load(cacheFile, CacheKey(mesh, voxelSize, band))) {
+        return field;
+    }
+
+    field.reset(new SignedDistanceField(mesh, voxelSize, band));
+    if (!field->Save(cacheFile)) {
+        std::cout << "ERROR::SDF: Failed to write cache: " << cacheFile << std::endl;
+    }
+    return field;
+}
+
+GLfloat SignedDistanceField::Distance(const glm::vec3& position) const
+{
+    const glm::vec3 g = (position - m_origin) / m_voxelSize;
+    const glm::vec3 brickF = glm::floor(g / static_cast<GLfloat>(BRICK_SIZE));
+    if (brickF.x < 0.0f || brickF.y < 0.0f || brickF.z < 0.0f ||
+        brickF.x >= m_bricks.x || brickF.y >= m_bricks.y || brickF.z >= m_bricks.z) {
+        return m_band;
+    }
+    const glm::ivec3 brick(brickF);
+    const int32_t offset = m_brickOffsets[BrickIndex(brick.x, brick.y, brick.z)];
+    if (offset < 0) {
+        return m_band;
+    }
+
+    const glm::vec3 local = g - glm::vec3(brick * BRICK_SIZE);
+    const int x0 = std::min(static_cast<int>(local.x), BRICK_SIZE - 1);
+    const int y0 = std::min(static_cast<int>(local.y), BRICK_SIZE - 1);
+    const int z0 = std::min(static_cast<int>(local.z), BRICK_SIZE - 1);
+    const GLfloat tx = local.x - x0;
+    const GLfloat ty = local.y - y0;
+    const GLfloat tz = local.z - z0;
+
+    const GLfloat* s = &m_samples[offset + (z0 * BRICK_SAMPLES + y0) * BRICK_SAMPLES + x0];
+    const int dy = BRICK_SAMPLES;
+    const int dz = BRICK_SAMPLES * BRICK_SAMPLES;
+    const GLfloat c00 = glm::mix(s[0], s[1], tx);
+    const GLfloat c10 = glm::mix(s[dy], s[dy + 1], tx);
+    const GLfloat c01 = glm::mix(s[dz], s[dz + 1], tx);
+    const GLfloat c11 = glm::mix(s[dz + dy], s[dz + dy + 1], tx);
+    return glm::mix(glm::mix(c00, c10, ty), glm::mix(c01, c11, ty), tz);
+}
+
+glm::vec3 SignedDistanceField::Gradient(const glm::vec3& position) const
+{
+    const GLfloat h = 0.5f * m_voxelSize;
+    return glm::vec3(Distance(position + glm::vec3(h, 0.0f, 0.0f)) - Distance(position - glm::vec3(h, 0.0f, 0.0f)),
+                     Distance(position + glm::vec3(0.0f, h, 0.0f)) - Distance(position - glm::vec3(0.0f, h, 0.0f)),
+                     Distance(position + glm::vec3(0.0f, 0.0f, h)) - Distance(position - glm::vec3(0.0f, 0.0f, h))) /
+           (2.0f * h);
+}
+
+bool SignedDistanceField::Save(const std::string& file) const
+{
+    std::ofstream stream(file, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+    const uint32_t magic = SDF_MAGIC;
+    const uint64_t nSamples = m_samples.size();
+    stream.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    stream.write(reinterpret_cast<const char*>(&m_key), sizeof(m_key));
+    stream.write(reinterpret_cast<const char*>(&m_voxelSize), sizeof(m_voxelSize));
+    stream.write(reinterpret_cast<const char*>(&m_band), sizeof(m_band));
+    stream.write(reinterpret_cast<const char*>(&m_origin), sizeof(m_origin));
+    stream.write(reinterpret_cast<const char*>(&m_bricks), sizeof(m_bricks));
+    stream.write(reinterpret_cast<const char*>(&nSamples), sizeof(nSamples));
+    stream.write(reinterpret_cast<const char*>(m_brickOffsets.data()),
+                 m_brickOffsets.size() * sizeof(int32_t));
+    stream.write(reinterpret_cast<const char*>(m_samples.data()), m_samples.size() * sizeof(GLfloat));
+    return static_cast<bool>(stream);
+}
+
+bool SignedDistanceField::Load(const std::string& file, uint64_t key)
+{
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream) {
+        return false;
+    }
+    uint32_t magic = 0;
+    uint64_t nSamples = 0;
+    stream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    stream.read(reinterpret_cast<char*>(&m_key), sizeof(m_key));
+    // a stale cache is simply rebuilt
+    if (!stream || magic != SDF_MAGIC || m_key != key) {
+        return false;
+    }
+    stream.read(reinterpret_cast<char*>(&m_voxelSize), sizeof(m_voxelSize));
+    stream.read(reinterpret_cast<char*>(&m_band), sizeof(m_band));
+    stream.read(reinterpret_cast<char*>(&m_origin), sizeof(m_origin));
+    stream.read(reinterpret_cast<char*>(&m_bricks), sizeof(m_bricks));
+    stream.read(reinterpret_cast<char*>(&nSamples), sizeof(nSamples));
+    if (!stream || m_bricks.x <= 0 || m_bricks.y <= 0 || m_bricks.z <= 0) {
+        return false;
+    }
+    // a truncated or corrupt cache must not size the arrays
+    const size_t nBricks = static_cast<size_t>(m_bricks.x) * m_bricks.y * m_bricks.z;
+    const std::streampos position = stream.tellg();
+    stream.seekg(0, std::ios::end);
+    const uint64_t remaining = static_cast<uint64_t>(stream.tellg() - position);
+    stream.seekg(position);
+    if (nSamples > remaining / sizeof(GLfloat) ||
+        remaining != nBricks * sizeof(int32_t) + nSamples * sizeof(GLfloat)) {
+        return false;
+    }
+    m_brickOffsets.resize(nBricks);
+    m_samples.resize(nSamples);
+    stream.read(reinterpret_cast<char*>(m_brickOffsets.data()), m_brickOffsets.size() * sizeof(int32_t));
+    stream.read(reinterpret_cast<char*>(m_samples.data()), m_samples.size() * sizeof(GLfloat));
+    if (!stream) {
+        return false;
+    }
+    // every brick's samples within m_samples, Distance doesn't check
+    const size_t brickSamples = static_cast<size_t>(BRICK_SAMPLES) * BRICK_SAMPLES * BRICK_SAMPLES;
+    return std::all_of(m_brickOffsets.begin(), m_brickOffsets.end(), [&](int32_t offset) {
+        return offset < 0 || static_cast<size_t>(offset) + brickSamples <= m_samples.size();
+    });
+}
+
+uint64_t SignedDistanceField::CacheKey(const TriangleMesh& mesh, GLfloat voxelSize, GLfloat band)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    HashBytes(hash, mesh.Vertices.data(), mesh.Vertices.size() * sizeof(glm::vec3));
+    HashBytes(hash, mesh.Triangles.data(), mesh.Triangles.size() * sizeof(glm::uvec3));
+    HashBytes(hash, &voxelSize, sizeof(voxelSize));
+    HashBytes(hash, &band, sizeof(band));
+    return hash;
+}
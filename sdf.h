@@ -0,0 +1,84 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mesh.h"
+
+// Narrow band signed distance field of static geometry, stored sparsely
+// in bricks of BRICK_SIZE^3 cells. Only bricks within the band of a
+// triangle hold samples, everything else reads as +band, so a lookup is
+// one brick table read and a trilinear fetch whatever the triangle
+// count. The sign comes from the angle weighted pseudo normal of the
+// closest face, edge or vertex, so meshes are expected to be closed and
+// consistently wound.
+class SignedDistanceField {
+public:
+    static const int BRICK_SIZE = 8;
+
+    // Builds the field on the thread pool, voxelSize is the sample
+    // spacing and band the distance up to which values are exact
+    SignedDistanceField(const TriangleMesh& mesh, GLfloat voxelSize, GLfloat band);
+
+    // Loads mesh and returns its field, reusing "<meshFile>.sdf" when it
+    // was baked from the same mesh with the same parameters. Returns
+    // nullptr if the mesh can't be loaded
+    static std::shared_ptr<SignedDistanceField> LoadOrBuild(const std::string& meshFile,
+                                                            GLfloat voxelSize, GLfloat band);
+
+    // Distance to the surface, negative inside, band outside of the bricks
+    GLfloat Distance(const glm::vec3& position) const;
+    // Central difference gradient, points away from the surface
+    glm::vec3 Gradient(const glm::vec3& position) const;
+
+    GLfloat GetBand() const { return m_band; }
+
+    bool Save(const std::string& file) const;
+
+private:
+    SignedDistanceField() = default;
+    bool Load(const std::string& file, uint64_t key);
+
+    // Identifies mesh plus bake parameters in the cache file
+    static uint64_t CacheKey(const TriangleMesh& mesh, GLfloat voxelSize, GLfloat band);
+
+    // samples per brick side, bricks share their border samples
+    static const int BRICK_SAMPLES = BRICK_SIZE + 1;
+
+    size_t BrickIndex(int x, int y, int z) const
+    {
+        return (static_cast<size_t>(z) * m_bricks.y + y) * m_bricks.x + x;
+    }
+
+    uint64_t m_key = 0;
+    GLfloat m_voxelSize = 1.0f;
+    GLfloat m_band = 0.0f;
+    glm::vec3 m_origin = glm::vec3(0.0f);
+    glm::ivec3 m_bricks = glm::ivec3(0);
+
+    // per brick cell: offset of its samples in m_samples, -1 when empty
+    std::vector<int32_t> m_brickOffsets;
+    std::vector<GLfloat> m_samples;
+};
+
+// What happens to a particle that reaches a surface
+enum class CollisionResponse {
+    // loses the velocity into the surface
+    slide,
+    // reflects the velocity into the surface, scaled by restitution
+    bounce,
+    // dies on contact
+    kill
+};
+
+// Scene geometry particles collide with, disabled without a field
+struct Collider {
+    std::shared_ptr<const SignedDistanceField> field;
+    CollisionResponse response = CollisionResponse::slide;
+    GLfloat restitution = 0.3f;
+};
@@ -49,6 +49,7 @@ void Shader::Compile(const GLchar* vertexSource, const GLchar* fragmentSource, c
         glAttachShader(this->ID, gShader);
     glLinkProgram(this->ID);
     checkCompileErrors(this->ID, "PROGRAM");
+    cacheUniformLocations();
 
     // Delete the shaders as they're linked into our program now and no longer necessery
     glDeleteShader(sVertex);
@@ -61,57 +62,112 @@ void Shader::SetFloat(const GLchar *name, GLfloat value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1f(glGetUniformLocation(this->ID, name), value);
+    glUniform1f(GetUniformLocation(name), value);
 }
 void Shader::SetInteger(const GLchar *name, GLint value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform1i(glGetUniformLocation(this->ID, name), value);
+    glUniform1i(GetUniformLocation(name), value);
 }
 void Shader::SetVector2f(const GLchar *name, GLfloat x, GLfloat y, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->ID, name), x, y);
+    glUniform2f(GetUniformLocation(name), x, y);
 }
 void Shader::SetVector2f(const GLchar *name, const glm::vec2 &value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->ID, name), value.x, value.y);
+    glUniform2f(GetUniformLocation(name), value.x, value.y);
 }
 void Shader::SetVector3f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->ID, name), x, y, z);
+    glUniform3f(GetUniformLocation(name), x, y, z);
 }
 void Shader::SetVector3f(const GLchar *name, const glm::vec3 &value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z);
+    glUniform3f(GetUniformLocation(name), value.x, value.y, value.z);
 }
 void Shader::SetVector4f(const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->ID, name), x, y, z, w);
+    glUniform4f(GetUniformLocation(name), x, y, z, w);
 }
 void Shader::SetVector4f(const GLchar *name, const glm::vec4 &value, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->ID, name), value.x, value.y, value.z, value.w);
+    glUniform4f(GetUniformLocation(name), value.x, value.y, value.z, value.w);
 }
 void Shader::SetMatrix4(const GLchar *name, const glm::mat4 &matrix, GLboolean useShader)
 {
     if (useShader)
         this->Use();
-    glUniformMatrix4fv(glGetUniformLocation(this->ID, name), 1, GL_FALSE, glm::value_ptr(matrix));
+    glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(matrix));
 }
 
+void Shader::SetFloat(GLint location, GLfloat value)
+{
+    glUniform1f(location, value);
+}
+void Shader::SetInteger(GLint location, GLint value)
+{
+    glUniform1i(location, value);
+}
+void Shader::SetVector3f(GLint location, const glm::vec3 &value)
+{
+    glUniform3f(location, value.x, value.y, value.z);
+}
+void Shader::SetVector4f(GLint location, const glm::vec4 &value)
+{
+    glUniform4f(location, value.x, value.y, value.z, value.w);
+}
+void Shader::SetMatrix4(GLint location, const glm::mat4 &matrix)
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+}
+
+GLint Shader::GetUniformLocation(const GLchar *name) const
+{
+    const auto iter = m_uniformLocations.find(name);
+    return iter != m_uniformLocations.end() ? iter->second : -1;
+}
+
+void Shader::cacheUniformLocations()
+{
+    m_uniformLocations.clear();
+
+    GLint nUniforms = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &nUniforms);
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(maxLength, '\0');
+    for (GLint i = 0; i < nUniforms; ++i)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(this->ID, i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniform(name.data(), length);
+        // Block members have no location of their own
+        const GLint location = glGetUniformLocation(this->ID, uniform.c_str());
+        if (location < 0)
+            continue;
+        // Arrays are reported as "name[0]", make them reachable by plain name too
+        const size_t bracket = uniform.find("[0]");
+        if (bracket != std::string::npos)
+            m_uniformLocations[uniform.substr(0, bracket)] = location;
+        m_uniformLocations[uniform] = location;
+    }
+}
 
 void Shader::checkCompileErrors(GLuint object, const std::string& type)
 {
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
@@ -29,6 +30,9 @@ public:
     Shader& Use();
     // Compiles the shader from given source code
     void Compile(const GLchar *vertexSource, const GLchar *fragmentSource, const GLchar *geometrySource = nullptr); // Note: geometry source code is optional
+    // Returns the location resolved at link time, -1 if the program has no
+    // such active uniform. Cache it to skip the name lookup in hot paths
+    GLint GetUniformLocation(const GLchar *name) const;
     // Utility functions
     void SetFloat    (const GLchar *name, GLfloat value, GLboolean useShader = false);
     void SetInteger  (const GLchar *name, GLint value, GLboolean useShader = false);
@@ -39,7 +43,17 @@ public:
     void SetVector4f (const GLchar *name, GLfloat x, GLfloat y, GLfloat z, GLfloat w, GLboolean useShader = false);
     void SetVector4f (const GLchar *name, const glm::vec4 &value, GLboolean useShader = false);
     void SetMatrix4  (const GLchar *name, const glm::mat4 &matrix, GLboolean useShader = false);
+    // Same as above for a location from GetUniformLocation()
+    void SetFloat    (GLint location, GLfloat value);
+    void SetInteger  (GLint location, GLint value);
+    void SetVector3f (GLint location, const glm::vec3 &value);
+    void SetVector4f (GLint location, const glm::vec4 &value);
+    void SetMatrix4  (GLint location, const glm::mat4 &matrix);
 private:
+    // Queries all active uniforms of the linked program once
+    void cacheUniformLocations();
+
+    std::unordered_map<std::string, GLint> m_uniformLocations;
     // Checks if compilation or linking failed and if so, print the error logs
     void checkCompileErrors(GLuint object, const std::string& type);
 };
@@ -0,0 +1,12 @@
+#version 450 core
+
+in vec2 TexCoords;
+out vec4 color;
+
+// reduced resolution particle pass, sampled bilinearly
+uniform sampler2D particles;
+
+void main()
+{
+    color = vec4(texture(particles, TexCoords).rgb, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 450 core
+
+out vec2 TexCoords;
+
+// Fullscreen triangle from the vertex index, no attributes
+void main()
+{
+    const vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
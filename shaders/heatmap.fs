@@ -0,0 +1,25 @@
+#version 450 core
+
+in vec2 TexCoords;
+out vec4 color;
+
+// fragments per pixel
+uniform sampler2D overdraw;
+// count shown as the hottest color
+uniform float range;
+
+void main()
+{
+    float count = texture(overdraw, TexCoords).r;
+    if (count == 0.0) {
+        color = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    // blue, green, yellow, red and white past the range
+    float t = clamp(log2(count + 1.0) / log2(range + 1.0), 0.0, 1.0) * 4.0;
+    const vec3 stops[5] = vec3[](vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0),
+                                 vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0),
+                                 vec3(1.0, 1.0, 1.0));
+    int i = min(int(t), 3);
+    color = vec4(mix(stops[i], stops[i + 1], t - float(i)), 1.0);
+}
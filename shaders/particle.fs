@@ -2,11 +2,18 @@
 
 in vec2 TexCoords;
 in vec4 ParticleColor;
+flat in uint Layer;
 out vec4 color;
 
-uniform sampler2D sprite;
+uniform sampler2DArray sprite;
+// counts fragments instead, see OverdrawMeter
+uniform bool overdraw;
 
 void main()
 {
-    color = (texture(sprite, TexCoords) * ParticleColor);
+    if (overdraw) {
+        color = vec4(1.0);
+        return;
+    }
+    color = (texture(sprite, vec3(TexCoords, Layer)) * ParticleColor);
 }
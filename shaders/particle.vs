@@ -5,17 +5,24 @@ layout(location = 1) in vec2 aTexCoords;
 layout(location = 2) in vec3 aOffset;
 layout(location = 3) in vec4 aColor;
 layout(location = 4) in float aScale;
+layout(location = 5) in uint aLayer;
 
 out vec2 TexCoords;
 out vec4 ParticleColor;
+flat out uint Layer;
+
+layout(std140, binding = 0) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 cameraPosition;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
 void main()
 {
     TexCoords = aTexCoords;
     ParticleColor = aColor;
+    Layer = aLayer;
     gl_Position = projection * view * model * vec4((aPos * aScale) + aOffset, 1.0);
 }
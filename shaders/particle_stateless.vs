@@ -0,0 +1,49 @@
+#version 450 core
+
+layout (location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoords;
+layout(location = 2) in vec4 aPositionSpawn;
+layout(location = 3) in vec4 aVelocityLife;
+layout(location = 4) in vec4 aColor;
+layout(location = 5) in float aScale;
+layout(location = 6) in uint aLayer;
+
+out vec2 TexCoords;
+out vec4 ParticleColor;
+flat out uint Layer;
+
+layout(std140, binding = 0) uniform Frame {
+    mat4 projection;
+    mat4 view;
+    vec4 cameraPosition;
+};
+
+uniform mat4 model;
+// emitter clock, the spawn times use the same base
+uniform float emitterTime;
+
+// the CPU path adds 0.02 along the launch direction every frame, ~60 fps
+const float ACCELERATION = 1.2;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Layer = aLayer;
+
+    float age = emitterTime - aPositionSpawn.w;
+    float life = aVelocityLife.w;
+    if (life <= 0.0 || age >= life) {
+        // expired or never used slot, place it outside the clip volume
+        ParticleColor = vec4(0.0);
+        gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+        return;
+    }
+
+    float remaining = 1.0 - age / life;
+    vec3 velocity = aVelocityLife.xyz;
+    vec3 direction = length(velocity) > 0.0 ? normalize(velocity) : vec3(0.0);
+    vec3 offset = aPositionSpawn.xyz + velocity * age + 0.5 * ACCELERATION * direction * age * age;
+
+    ParticleColor = vec4(aColor.rgb, remaining);
+    gl_Position = projection * view * model * vec4((aPos * aScale * remaining) + offset, 1.0);
+}
@@ -0,0 +1,390 @@
+#include "shared_frames.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+#include <new>
+#include <type_traits>
+
+// "FIRE" in memory order
+#define SHARED_FRAMES_MAGIC 0x45524946u
+#define SHARED_FRAMES_VERSION 1u
+
+namespace {
+
+size_t Align(size_t size)
+{
+    return (size + 63) & ~static_cast<size_t>(63);
+}
+
+// Byte offsets of the parts of a slot, see shared_frames.h
+struct SlotLayout {
+    size_t emitters;
+    size_t offsets;
+    size_t colors;
+    size_t scales;
+    size_t layers;
+    size_t size;
+
+    SlotLayout(size_t maxParticles, size_t maxEmitters)
+    {
+        emitters = Align(sizeof(SharedSlotHeader));
+        offsets = emitters + Align(sizeof(SharedEmitter) * maxEmitters);
+        colors = offsets + Align(sizeof(glm::vec3) * maxParticles);
+        scales = colors + Align(sizeof(glm::vec4) * maxParticles);
+        layers = scales + Align(sizeof(GLfloat) * maxParticles);
+        size = layers + Align(sizeof(GLuint) * maxParticles);
+    }
+};
+
+template <typename T, typename Header>
+T* SlotPart(Header* header, uint64_t frame, size_t offset)
+{
+    const size_t slot = frame % header->nSlots;
+    using Byte = typename std::conditional<std::is_const<Header>::value, const char, char>::type;
+    Byte* base = reinterpret_cast<Byte*>(header) + Align(sizeof(SharedFrameHeader)) +
+                 slot * header->slotBytes;
+    return reinterpret_cast<T*>(base + offset);
+}
+
+} // namespace
+
+// SharedFramePublisher {{{
+SharedFramePublisher::SharedFramePublisher()
+    : m_memory(nullptr),
+      m_size(0),
+      m_header(nullptr),
+      m_nPublished(0),
+      m_nTruncated(0)
+{
+}
+
+SharedFramePublisher::~SharedFramePublisher()
+{
+    if (m_memory) {
+        munmap(m_memory, m_size);
+        shm_unlink(m_name.c_str());
+    }
+}
+
+bool SharedFramePublisher::Open(const std::string& name, size_t maxParticles, size_t maxEmitters,
+                                GLuint nSlots)
+{
+    const SlotLayout layout(maxParticles, maxEmitters);
+    const size_t size = Align(sizeof(SharedFrameHeader)) + layout.size * nSlots;
+
+    // a fresh object, readers of an old one keep their stale mapping
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cout << "ERROR::SHARED_FRAMES: Failed to create shared memory " << name << std::endl;
+        return false;
+    }
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::cout << "ERROR::SHARED_FRAMES: Failed to map " << size << " bytes of " << name
+                  << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    m_name = name;
+    m_memory = memory;
+    m_size = size;
+    m_header = new (memory) SharedFrameHeader();
+    m_header->version = SHARED_FRAMES_VERSION;
+    m_header->nSlots = nSlots;
+    m_header->maxEmitters = maxEmitters;
+    m_header->maxParticles = maxParticles;
+    m_header->slotBytes = layout.size;
+    m_header->nPublished.store(0, std::memory_order_relaxed);
+    for (GLuint i = 0; i < nSlots; ++i) {
+        new (SlotPart<SharedSlotHeader>(m_header, i, 0)) SharedSlotHeader();
+    }
+    // readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = SHARED_FRAMES_MAGIC;
+    return true;
+}
+
+void SharedFramePublisher::Publish(const EmitterManager& emitters)
+{
+    if (!m_header) {
+        return;
+    }
+    const uint64_t frame = m_nPublished;
+    const SlotLayout layout(m_header->maxParticles, m_header->maxEmitters);
+    SharedSlotHeader* slot = SlotPart<SharedSlotHeader>(m_header, frame, 0);
+
+    // Odd while writing, the fence keeps the data writes after it
+    slot->sequence.store(2 * frame + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    SharedEmitter* records = SlotPart<SharedEmitter>(m_header, frame, layout.emitters);
+    glm::vec3* offsets = SlotPart<glm::vec3>(m_header, frame, layout.offsets);
+    glm::vec4* colors = SlotPart<glm::vec4>(m_header, frame, layout.colors);
+    GLfloat* scales = SlotPart<GLfloat>(m_header, frame, layout.scales);
+    GLuint* layers = SlotPart<GLuint>(m_header, frame, layout.layers);
+
+    m_handles.clear();
+    emitters.GetHandles(m_handles);
+    size_t nEmitters = 0;
+    size_t nParticles = 0;
+    for (const EmitterHandle handle : m_handles) {
+        const Emitter* emitter = emitters.Get(handle);
+        if (nEmitters == m_header->maxEmitters) {
+            m_nTruncated += emitter->GetParticleCount();
+            continue;
+        }
+        const size_t capacity = m_header->maxParticles - nParticles;
+        const size_t count = emitter->Export(offsets + nParticles, colors + nParticles,
+                                             scales + nParticles, layers + nParticles, capacity);
+        m_nTruncated += emitter->GetParticleCount() - std::min(count, emitter->GetParticleCount());
+        if (count > 0) {
+            records[nEmitters++] = {emitter->GetPosition(), static_cast<uint32_t>(nParticles),
+                                    static_cast<uint32_t>(count)};
+            nParticles += count;
+        }
+    }
+    slot->nEmitters = nEmitters;
+    slot->nParticles = nParticles;
+
+    slot->sequence.store(2 * (frame + 1), std::memory_order_release);
+    m_header->nPublished.store(frame + 1, std::memory_order_release);
+    ++m_nPublished;
+}
+// }}}
+
+// SharedFrameReader {{{
+SharedFrameReader::SharedFrameReader()
+    : m_memory(nullptr),
+      m_size(0),
+      m_header(nullptr),
+      m_hasFrame(false),
+      m_lastFrame(0),
+      m_nRead(0),
+      m_nTorn(0),
+      m_nDropped(0)
+{
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+    if (m_memory) {
+        munmap(const_cast<void*>(m_memory), m_size);
+    }
+}
+
+bool SharedFrameReader::Open(const std::string& name)
+{
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cout << "ERROR::SHARED_FRAMES: No publisher at " << name << std::endl;
+        return false;
+    }
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(SharedFrameHeader)) {
+        memory = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::cout << "ERROR::SHARED_FRAMES: Failed to map " << name << std::endl;
+        return false;
+    }
+
+    const SharedFrameHeader* header = static_cast<const SharedFrameHeader*>(memory);
+    const bool valid = header->magic == SHARED_FRAMES_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid || header->version != SHARED_FRAMES_VERSION || header->nSlots == 0 ||
+        Align(sizeof(SharedFrameHeader)) + header->slotBytes * header->nSlots >
+            static_cast<size_t>(status.st_size)) {
+        std::cout << "ERROR::SHARED_FRAMES: " << name << " is not a frame ring of version "
+                  << SHARED_FRAMES_VERSION << std::endl;
+        munmap(memory, status.st_size);
+        return false;
+    }
+    m_memory = memory;
+    m_size = status.st_size;
+    m_header = header;
+    return true;
+}
+
+bool SharedFrameReader::Acquire(SharedFrame& frame)
+{
+    if (!m_header) {
+        return false;
+    }
+    const uint64_t nPublished = m_header->nPublished.load(std::memory_order_acquire);
+    if (nPublished == 0 || (m_hasFrame && nPublished - 1 == m_lastFrame)) {
+        return false;
+    }
+    frame.frame = nPublished - 1;
+    const SharedSlotHeader* slot = SlotPart<const SharedSlotHeader>(m_header, frame.frame, 0);
+    frame.sequence = slot->sequence.load(std::memory_order_acquire);
+    // The publisher lapped the ring and is rewriting the slot
+    if (frame.sequence != 2 * (frame.frame + 1)) {
+        ++m_nTorn;
+        return false;
+    }
+
+    const SlotLayout layout(m_header->maxParticles, m_header->maxEmitters);
+    // bounded, a torn header must not send the caller out of the slot
+    frame.nEmitters = std::min<uint32_t>(slot->nEmitters, m_header->maxEmitters);
+    frame.nParticles = std::min<uint64_t>(slot->nParticles, m_header->maxParticles);
+    frame.emitters = SlotPart<const SharedEmitter>(m_header, frame.frame, layout.emitters);
+    frame.offsets = SlotPart<const glm::vec3>(m_header, frame.frame, layout.offsets);
+    frame.colors = SlotPart<const glm::vec4>(m_header, frame.frame, layout.colors);
+    frame.scales = SlotPart<const GLfloat>(m_header, frame.frame, layout.scales);
+    frame.layers = SlotPart<const GLuint>(m_header, frame.frame, layout.layers);
+    return true;
+}
+
+bool SharedFrameReader::Validate(const SharedFrame& frame)
+{
+    // the data reads above stay before the second sequence load
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const SharedSlotHeader* slot = SlotPart<const SharedSlotHeader>(m_header, frame.frame, 0);
+    if (slot->sequence.load(std::memory_order_relaxed) != frame.sequence) {
+        ++m_nTorn;
+        return false;
+    }
+    if (m_hasFrame) {
+        m_nDropped += frame.frame - m_lastFrame - 1;
+    }
+    m_hasFrame = true;
+    m_lastFrame = frame.frame;
+    ++m_nRead;
+    return true;
+}
+
+size_t SharedFrameReader::GetMaxParticles() const
+{
+    return m_header ? m_header->maxParticles : 0;
+}
+
+size_t SharedFrameReader::GetMaxEmitters() const
+{
+    return m_header ? m_header->maxEmitters : 0;
+}
+// }}}
+
+// SharedFrameViewer {{{
+SharedFrameViewer::SharedFrameViewer(const Shader& shader, const Texture2DArray& texture)
+    : m_shader(shader),
+      m_texture(texture),
+      m_modelLocation(-1),
+      m_front(0)
+{
+}
+
+SharedFrameViewer::~SharedFrameViewer()
+{
+    for (Buffers& buffers : m_buffers) {
+        if (buffers.VAO != 0) {
+            const GLuint vbos[] = {buffers.meshVBO, buffers.offsetVBO, buffers.colorVBO,
+                                   buffers.scaleVBO, buffers.layerVBO};
+            glDeleteBuffers(sizeof(vbos) / sizeof(vbos[0]), vbos);
+            glDeleteVertexArrays(1, &buffers.VAO);
+        }
+    }
+}
+
+bool SharedFrameViewer::Open(const std::string& name)
+{
+    if (!m_reader.Open(name)) {
+        return false;
+    }
+    m_modelLocation = m_shader.GetUniformLocation("model");
+    for (Buffers& buffers : m_buffers) {
+        InitBuffers(buffers);
+    }
+    return true;
+}
+
+void SharedFrameViewer::InitBuffers(Buffers& buffers)
+{
+    const size_t capacity = m_reader.GetMaxParticles();
+    glGenVertexArrays(1, &buffers.VAO);
+    buffers.meshVBO = Emitter::InitMesh(buffers.VAO);
+
+    glCreateBuffers(1, &buffers.offsetVBO);
+    glCreateBuffers(1, &buffers.colorVBO);
+    glCreateBuffers(1, &buffers.scaleVBO);
+    glCreateBuffers(1, &buffers.layerVBO);
+    glNamedBufferStorage(buffers.offsetVBO, sizeof(glm::vec3) * capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(buffers.colorVBO, sizeof(glm::vec4) * capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(buffers.scaleVBO, sizeof(GLfloat) * capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    glNamedBufferStorage(buffers.layerVBO, sizeof(GLuint) * capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    // same attributes as the emitters, see particle.vs
+    glBindVertexArray(buffers.VAO);
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.offsetVBO);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glVertexAttribDivisor(2, 1);
+
+    glEnableVertexAttribArray(3);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.colorVBO);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glVertexAttribDivisor(3, 1);
+
+    glEnableVertexAttribArray(4);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.scaleVBO);
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, 1 * sizeof(float), (void*)0);
+    glVertexAttribDivisor(4, 1);
+
+    glEnableVertexAttribArray(5);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.layerVBO);
+    glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, 1 * sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(5, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void SharedFrameViewer::Draw()
+{
+    SharedFrame frame;
+    if (m_reader.Acquire(frame)) {
+        // 1. Upload into the back buffers straight from the mapping
+        Buffers& back = m_buffers[1 - m_front];
+        const size_t n = frame.nParticles;
+        glNamedBufferSubData(back.offsetVBO, 0, sizeof(glm::vec3) * n, frame.offsets);
+        glNamedBufferSubData(back.colorVBO, 0, sizeof(glm::vec4) * n, frame.colors);
+        glNamedBufferSubData(back.scaleVBO, 0, sizeof(GLfloat) * n, frame.scales);
+        glNamedBufferSubData(back.layerVBO, 0, sizeof(GLuint) * n, frame.layers);
+        back.emitters.assign(frame.emitters, frame.emitters + frame.nEmitters);
+
+        // 2. Swap only if the publisher left the slot alone meanwhile
+        if (m_reader.Validate(frame)) {
+            m_front = 1 - m_front;
+        }
+    }
+
+    const Buffers& front = m_buffers[m_front];
+    if (front.emitters.empty()) {
+        return;
+    }
+    // Use additive blending to give it a 'glow' effect
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    m_shader.Use();
+    m_texture.Bind();
+    glBindVertexArray(front.VAO);
+    for (const SharedEmitter& emitter : front.emitters) {
+        m_shader.SetMatrix4(m_modelLocation, glm::translate(glm::mat4(1.0f), emitter.position));
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, emitter.count, emitter.first);
+    }
+    glBindVertexArray(0);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+// }}}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "emitter_manager.h"
+#include "shader.h"
+#include "texture.h"
+
+// Particle frames shared between processes through a POSIX shared memory
+// ring of slots. The publisher writes every frame into the next slot
+// under a seqlock: the slot sequence is odd while the slot is written and
+// 2 * (frame + 1) once it is complete. Publishing never waits for
+// readers. Readers use the slot in place and check the sequence
+// afterwards, a changed sequence means the frame was torn.
+//
+// Slot layout: SharedSlotHeader, maxEmitters SharedEmitter records, then
+// maxParticles offsets, colors, scales and layers, the same arrays the
+// emitters upload to their buffers
+
+// Placement of one emitter's particles within a slot
+struct SharedEmitter {
+    glm::vec3 position;
+    uint32_t first;
+    uint32_t count;
+};
+
+struct SharedFrameHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nSlots;
+    uint32_t maxEmitters;
+    uint64_t maxParticles;
+    uint64_t slotBytes;
+    // frames published so far, the latest one is nPublished - 1
+    std::atomic<uint64_t> nPublished;
+};
+
+struct SharedSlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint32_t nEmitters;
+    uint32_t nParticles;
+};
+
+// A slot as seen by a reader. The pointers stay valid while the reader is
+// open, the contents only until Validate said they were intact
+struct SharedFrame {
+    uint64_t frame;
+    uint64_t sequence;
+    uint32_t nEmitters;
+    uint32_t nParticles;
+    const SharedEmitter* emitters;
+    const glm::vec3* offsets;
+    const glm::vec4* colors;
+    const GLfloat* scales;
+    const GLuint* layers;
+};
+
+// Creates the shared memory object and writes frames into it. The object
+// is unlinked again when the publisher goes away
+class SharedFramePublisher {
+public:
+    SharedFramePublisher();
+    ~SharedFramePublisher();
+
+    SharedFramePublisher(const SharedFramePublisher&) = delete;
+    SharedFramePublisher& operator=(const SharedFramePublisher&) = delete;
+
+    // name as for shm_open, e.g. "/fire". Replaces an existing object of
+    // that name. Prints an error and returns false on failure
+    bool Open(const std::string& name, size_t maxParticles, size_t maxEmitters, GLuint nSlots = 4);
+    // Writes the live particles of all emitters as the next frame, no
+    // emitter may update meanwhile. Particles beyond maxParticles and
+    // emitters beyond maxEmitters are left out
+    void Publish(const EmitterManager& emitters);
+
+    uint64_t GetPublishedCount() const { return m_nPublished; }
+    // particles left out so far
+    size_t GetTruncatedCount() const { return m_nTruncated; }
+
+private:
+    std::string m_name;
+    void* m_memory;
+    size_t m_size;
+    SharedFrameHeader* m_header;
+    uint64_t m_nPublished;
+    size_t m_nTruncated;
+    std::vector<EmitterHandle> m_handles;
+};
+
+// Maps the frames of a publisher read-only
+class SharedFrameReader {
+public:
+    SharedFrameReader();
+    ~SharedFrameReader();
+
+    SharedFrameReader(const SharedFrameReader&) = delete;
+    SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+
+    // Prints an error and returns false if there is no publisher of that
+    // name or its layout differs
+    bool Open(const std::string& name);
+    // The latest frame if it is newer than the last valid one, false if
+    // there is none or its slot is being rewritten already
+    bool Acquire(SharedFrame& frame);
+    // Call once done with the data of an acquired frame. False if the
+    // publisher overwrote the slot in the meantime, drop the frame then
+    bool Validate(const SharedFrame& frame);
+
+    size_t GetMaxParticles() const;
+    size_t GetMaxEmitters() const;
+    // valid frames, torn ones and frames published in between valid ones
+    // that were never seen
+    size_t GetReadCount() const { return m_nRead; }
+    size_t GetTornCount() const { return m_nTorn; }
+    size_t GetDroppedCount() const { return m_nDropped; }
+
+private:
+    const void* m_memory;
+    size_t m_size;
+    const SharedFrameHeader* m_header;
+    bool m_hasFrame;
+    uint64_t m_lastFrame;
+    size_t m_nRead;
+    size_t m_nTorn;
+    size_t m_nDropped;
+};
+
+// Draws the frames of a publisher with the particle shader, uploading
+// straight from the shared memory. Uploads go to a second set of buffers
+// so a torn frame never reaches the screen, the last valid one stays
+class SharedFrameViewer {
+public:
+    // No GL calls here, Game is constructed before the context exists
+    SharedFrameViewer(const Shader& shader, const Texture2DArray& texture);
+    ~SharedFrameViewer();
+
+    SharedFrameViewer(const SharedFrameViewer&) = delete;
+    SharedFrameViewer& operator=(const SharedFrameViewer&) = delete;
+
+    // Opens the reader and creates the buffers
+    bool Open(const std::string& name);
+    // Uploads the latest frame if there is a new one, then draws the
+    // last valid frame
+    void Draw();
+
+    const SharedFrameReader& GetReader() const { return m_reader; }
+
+private:
+    struct Buffers {
+        GLuint VAO = 0;
+        GLuint meshVBO = 0;
+        GLuint offsetVBO = 0;
+        GLuint colorVBO = 0;
+        GLuint scaleVBO = 0;
+        GLuint layerVBO = 0;
+        std::vector<SharedEmitter> emitters;
+    };
+
+    void InitBuffers(Buffers& buffers);
+
+    Shader m_shader;
+    Texture2DArray m_texture;
+    GLint m_modelLocation;
+    SharedFrameReader m_reader;
+    Buffers m_buffers[2];
+    // index of the buffers holding the last valid frame
+    size_t m_front;
+};
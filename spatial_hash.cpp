@@ -0,0 +1,119 @@
+#include "spatial_hash.h"
+
+#include <algorithm>
+
+#include "thread_pool.h"
+
+// smallest bucket table, grown to the next power of two above the point count
+#define MIN_BUCKETS 1024
+// buckets per block of the parallel prefix sum
+#define SCAN_BLOCK 4096
+
+SpatialHash::SpatialHash(GLfloat cellSize)
+    : m_cellSize(cellSize),
+      m_invCellSize(1.0f / cellSize),
+      m_mask(0),
+      m_nCounts(0)
+{
+}
+
+void SpatialHash::Build(const glm::vec3* positions, size_t n)
+{
+    size_t nBuckets = MIN_BUCKETS;
+    while (nBuckets < n) {
+        nBuckets *= 2;
+    }
+    m_mask = nBuckets - 1;
+    if (m_nCounts != nBuckets) {
+        m_counts.reset(new std::atomic<GLuint>[nBuckets]);
+        m_nCounts = nBuckets;
+    }
+    m_bucketStart.resize(nBuckets + 1);
+    m_buckets.resize(n);
+    m_ranks.resize(n);
+    m_indices.resize(n);
+    m_positions.resize(n);
+    ThreadPool& pool = ThreadPool::Instance();
+
+    // 1. Histogram, bucket and rank within it are kept for the scatter
+    pool.ParallelFor(0, nBuckets, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            m_counts[b].store(0, std::memory_order_relaxed);
+        }
+    });
+    pool.ParallelFor(0, n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const GLuint bucket = Bucket(Cell(positions[i]));
+            m_buckets[i] = bucket;
+            m_ranks[i] = m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    // 2. Exclusive prefix sum in blocks: block totals, their scan, then
+    // each block scanned from its offset
+    const size_t nBlocks = (nBuckets + SCAN_BLOCK - 1) / SCAN_BLOCK;
+    m_blockSums.resize(nBlocks);
+    pool.ParallelFor(0, nBlocks, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            GLuint sum = 0;
+            for (size_t b = block * SCAN_BLOCK; b < std::min((block + 1) * SCAN_BLOCK, nBuckets); ++b) {
+                sum += m_counts[b].load(std::memory_order_relaxed);
+            }
+            m_blockSums[block] = sum;
+        }
+    });
+    GLuint total = 0;
+    for (auto& sum : m_blockSums) {
+        const GLuint blockSum = sum;
+        sum = total;
+        total += blockSum;
+    }
+    pool.ParallelFor(0, nBlocks, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; ++block) {
+            GLuint sum = m_blockSums[block];
+            for (size_t b = block * SCAN_BLOCK; b < std::min((block + 1) * SCAN_BLOCK, nBuckets); ++b) {
+                const GLuint count = m_counts[b].load(std::memory_order_relaxed);
+                m_bucketStart[b] = sum;
+                sum += count;
+            }
+        }
+    });
+    m_bucketStart[nBuckets] = total;
+
+    // 3. Scatter
+    pool.ParallelFor(0, n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            m_indices[m_bucketStart[m_buckets[i]] + m_ranks[i]] = i;
+        }
+    });
+
+    // 4. Ranks depend on thread timing, restore index order within the
+    // buckets so that sums over neighbours are reproducible
+    pool.ParallelFor(0, nBuckets, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b) {
+            // buckets hold a handful of points, insertion sort it is
+            for (GLuint i = m_bucketStart[b] + 1; i < m_bucketStart[b + 1]; ++i) {
+                const GLuint index = m_indices[i];
+                GLuint j = i;
+                for (; j > m_bucketStart[b] && m_indices[j - 1] > index; --j) {
+                    m_indices[j] = m_indices[j - 1];
+                }
+                m_indices[j] = index;
+            }
+        }
+    });
+    pool.ParallelFor(0, n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            m_positions[i] = positions[m_indices[i]];
+        }
+    });
+}
+
+size_t SpatialHash::Query(const glm::vec3& position, GLfloat radius, std::vector<GLuint>& out) const
+{
+    const size_t first = out.size();
+    ForEachNeighbor(position, radius, [&out](GLuint index, const glm::vec3&) {
+        out.push_back(index);
+    });
+    return out.size() - first;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Uniform grid over unbounded space, hashed into a fixed bucket table and
+// rebuilt from scratch every frame with a parallel counting sort. Points
+// of one bucket end up contiguous, so a query walks a few short ranges
+// and nothing is allocated per cell. Different cells can share a bucket,
+// queries filter by distance
+class SpatialHash {
+public:
+    explicit SpatialHash(GLfloat cellSize);
+
+    // Sorts n points into buckets, they are copied
+    void Build(const glm::vec3* positions, size_t n);
+
+    // Calls fn(index, offset) for each point within radius of position,
+    // index as passed to Build and offset the vector from it to position.
+    // radius must not exceed the cell size. Safe to call from several
+    // threads once built
+    template <typename F>
+    void ForEachNeighbor(const glm::vec3& position, GLfloat radius, F&& fn) const;
+
+    // Appends the indices of the points within radius of position to out
+    size_t Query(const glm::vec3& position, GLfloat radius, std::vector<GLuint>& out) const;
+
+    GLfloat GetCellSize() const { return m_cellSize; }
+    size_t Size() const { return m_positions.size(); }
+
+private:
+    GLuint Bucket(const glm::ivec3& cell) const
+    {
+        // Teschner et al., optimized spatial hashing
+        const uint32_t hash = (static_cast<uint32_t>(cell.x) * 73856093u) ^
+                              (static_cast<uint32_t>(cell.y) * 19349663u) ^
+                              (static_cast<uint32_t>(cell.z) * 83492791u);
+        return hash & m_mask;
+    }
+    glm::ivec3 Cell(const glm::vec3& position) const
+    {
+        return glm::ivec3(glm::floor(position * m_invCellSize));
+    }
+
+    const GLfloat m_cellSize;
+    const GLfloat m_invCellSize;
+    GLuint m_mask;
+
+    // m_bucketStart[b] .. m_bucketStart[b + 1] is the range of bucket b
+    // in the sorted arrays
+    std::vector<GLuint> m_bucketStart;
+    std::unique_ptr<std::atomic<GLuint>[]> m_counts;
+    size_t m_nCounts;
+    std::vector<GLuint> m_blockSums;
+    std::vector<GLuint> m_buckets;
+    std::vector<GLuint> m_ranks;
+    std::vector<GLuint> m_indices;
+    std::vector<glm::vec3> m_positions;
+};
+
+template <typename F>
+void SpatialHash::ForEachNeighbor(const glm::vec3& position, GLfloat radius, F&& fn) const
+{
+    if (m_positions.empty()) {
+        return;
+    }
+    const GLfloat radius2 = radius * radius;
+    const glm::ivec3 first = Cell(position - glm::vec3(radius));
+    const glm::ivec3 last = Cell(position + glm::vec3(radius));
+
+    // cells sharing a bucket must not report its points twice
+    GLuint visited[27];
+    size_t nVisited = 0;
+    for (int z = first.z; z <= last.z; ++z) {
+        for (int y = first.y; y <= last.y; ++y) {
+            for (int x = first.x; x <= last.x; ++x) {
+                const GLuint bucket = Bucket(glm::ivec3(x, y, z));
+                bool seen = false;
+                for (size_t i = 0; i < nVisited && !seen; ++i) {
+                    seen = visited[i] == bucket;
+                }
+                if (seen) {
+                    continue;
+                }
+                if (nVisited < 27) {
+                    visited[nVisited++] = bucket;
+                }
+
+                for (GLuint i = m_bucketStart[bucket]; i < m_bucketStart[bucket + 1]; ++i) {
+                    const glm::vec3 offset = position - m_positions[i];
+                    if (glm::dot(offset, offset) <= radius2) {
+                        fn(m_indices[i], offset);
+                    }
+                }
+            }
+        }
+    }
+}
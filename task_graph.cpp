@@ -0,0 +1,195 @@
+#include "task_graph.h"
+
+// Deque of the current thread, 0 outside of the scheduler's workers
+static thread_local size_t t_queue = 0;
+
+// TaskScheduler {{{
+TaskScheduler::TaskScheduler(size_t nThreads)
+    : m_nQueued(0),
+      m_stop(false)
+{
+    for (size_t i = 0; i <= nThreads; ++i) {
+        m_queues.emplace_back(new Queue());
+    }
+    m_workers.reserve(nThreads);
+    for (size_t i = 0; i < nThreads; ++i) {
+        m_workers.emplace_back(&TaskScheduler::WorkerLoop, this, i + 1);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+TaskScheduler& TaskScheduler::Instance()
+{
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+void TaskScheduler::Push(std::function<void()> job)
+{
+    Queue& queue = *m_queues[t_queue < m_queues.size() ? t_queue : 0];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    {
+        // under the lock, a worker about to sleep sees the count
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        ++m_nQueued;
+    }
+    m_wake.notify_one();
+}
+
+bool TaskScheduler::RunOne()
+{
+    const size_t self = t_queue < m_queues.size() ? t_queue : 0;
+    std::function<void()> job;
+    // newest of our own first, then the oldest of the others
+    for (size_t i = 0; i < m_queues.size() && !job; ++i) {
+        Queue& queue = *m_queues[(self + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        } else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+    }
+    if (!job) {
+        return false;
+    }
+    --m_nQueued;
+    job();
+    return true;
+}
+
+void TaskScheduler::WorkerLoop(size_t index)
+{
+    t_queue = index;
+    for (;;) {
+        if (RunOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return m_stop || m_nQueued > 0; });
+        if (m_stop) {
+            return;
+        }
+    }
+}
+// }}}
+
+// TaskGraph {{{
+TaskGraph::TaskId TaskGraph::Add(std::string name, std::function<void()> job, bool pinned)
+{
+    m_tasks.push_back({std::move(name), std::move(job), pinned, {}, 0});
+    return m_tasks.size() - 1;
+}
+
+void TaskGraph::Precede(TaskId before, TaskId after)
+{
+    m_tasks[before].successors.push_back(after);
+    ++m_tasks[after].nPredecessors;
+}
+
+void TaskGraph::Clear()
+{
+    m_tasks.clear();
+}
+
+void TaskGraph::Run(TaskScheduler& scheduler)
+{
+    const size_t nTasks = m_tasks.size();
+    m_scheduler = &scheduler;
+    m_timings.assign(nTasks, TaskTiming());
+    m_pending.reset(new std::atomic<size_t>[nTasks]);
+    for (TaskId id = 0; id < nTasks; ++id) {
+        m_timings[id].name = m_tasks[id].name;
+        m_pending[id] = m_tasks[id].nPredecessors;
+    }
+    m_nRemaining = nTasks;
+    m_start = std::chrono::steady_clock::now();
+
+    // 1. Roots
+    for (TaskId id = 0; id < nTasks; ++id) {
+        if (m_tasks[id].nPredecessors == 0) {
+            Release(id);
+        }
+    }
+
+    // 2. Pinned tasks as they become ready, other work in between
+    while (m_nRemaining > 0) {
+        TaskId pinned = nTasks;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_pinned.empty()) {
+                pinned = m_pinned.back();
+                m_pinned.pop_back();
+            }
+        }
+        if (pinned < nTasks) {
+            Execute(pinned);
+            continue;
+        }
+        if (scheduler.RunOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]() { return !m_pinned.empty() || m_nRemaining == 0; });
+    }
+    // the last task may still hold the lock
+    std::lock_guard<std::mutex> lock(m_mutex);
+}
+
+void TaskGraph::Release(TaskId id)
+{
+    if (m_tasks[id].pinned) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pinned.push_back(id);
+        }
+        m_condition.notify_all();
+    } else {
+        m_scheduler->Push([this, id]() { Execute(id); });
+    }
+}
+
+void TaskGraph::Execute(TaskId id)
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point begin = Clock::now();
+    m_tasks[id].job();
+    const Clock::time_point end = Clock::now();
+
+    TaskTiming& timing = m_timings[id];
+    timing.thread = t_queue;
+    timing.startMs = std::chrono::duration<double, std::milli>(begin - m_start).count();
+    timing.durationMs = std::chrono::duration<double, std::milli>(end - begin).count();
+
+    for (TaskId successor : m_tasks[id].successors) {
+        if (--m_pending[successor] == 0) {
+            Release(successor);
+        }
+    }
+    // Under the lock so Run can't miss it between check and wait, nor
+    // return while this thread still touches the graph
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_nRemaining == 0) {
+        m_condition.notify_all();
+    }
+}
+// }}}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Worker threads with one deque each. Owners take their newest job,
+// idle workers steal the oldest job of another deque, so successors of a
+// task tend to run on the thread that produced their data. Runs the jobs
+// of TaskGraph; unlike ThreadPool its workers may call
+// ThreadPool::ParallelFor
+class TaskScheduler {
+public:
+    // The thread calling TaskGraph::Run works as well, hence one less
+    explicit TaskScheduler(size_t nThreads = std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    size_t Size() const { return m_workers.size(); }
+
+    // Process-wide scheduler for the frame graph
+    static TaskScheduler& Instance();
+
+private:
+    friend class TaskGraph;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    // Queues onto the deque of the calling thread
+    void Push(std::function<void()> job);
+    // Runs one job of the calling thread's deque or a stolen one, false
+    // if there was none
+    bool RunOne();
+    void WorkerLoop(size_t index);
+
+    // [0] belongs to the threads outside the scheduler
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_nQueued;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    bool m_stop;
+};
+
+// Execution record of one task, times relative to the start of Run
+struct TaskTiming {
+    std::string name;
+    // 0 is the thread calling Run, workers count from 1
+    size_t thread;
+    double startMs;
+    double durationMs;
+};
+
+// Directed acyclic graph of jobs, built and run once per frame. A task
+// starts once all of its predecessors finished. Pinned tasks run on the
+// thread calling Run, for everything touching the GL context
+class TaskGraph {
+public:
+    using TaskId = size_t;
+
+    TaskId Add(std::string name, std::function<void()> job, bool pinned = false);
+    // after waits for before
+    void Precede(TaskId before, TaskId after);
+
+    // Runs all tasks and returns when they are done, the calling thread
+    // helps out with unpinned tasks while it waits
+    void Run(TaskScheduler& scheduler = TaskScheduler::Instance());
+    // Drops the tasks, the timings of the last Run stay
+    void Clear();
+
+    size_t Size() const { return m_tasks.size(); }
+    // One entry per task of the last Run, in TaskId order
+    const std::vector<TaskTiming>& GetTimings() const { return m_timings; }
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> job;
+        bool pinned;
+        std::vector<TaskId> successors;
+        size_t nPredecessors;
+    };
+
+    // Runs the task, then releases the successors it was the last
+    // predecessor of
+    void Execute(TaskId id);
+    void Release(TaskId id);
+
+    std::vector<Task> m_tasks;
+    std::vector<TaskTiming> m_timings;
+
+    // Run state
+    TaskScheduler* m_scheduler = nullptr;
+    std::unique_ptr<std::atomic<size_t>[]> m_pending;
+    std::atomic<size_t> m_nRemaining;
+    std::chrono::steady_clock::time_point m_start;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    // ready pinned tasks, guarded by m_mutex
+    std::vector<TaskId> m_pinned;
+};
@@ -45,3 +45,57 @@ void Texture2D::Bind() const
 {
     glBindTexture(GL_TEXTURE_2D, this->ID);
 }
+
+Texture2DArray::Texture2DArray()
+    : Width(0),
+      Height(0),
+      Layers(0),
+      Internal_Format(GL_RGB),
+      Image_Format(GL_RGB),
+      Wrap_S(GL_CLAMP_TO_EDGE),
+      Wrap_T(GL_CLAMP_TO_EDGE),
+      Filter_Min(GL_LINEAR_MIPMAP_LINEAR),
+      Filter_Max(GL_LINEAR)
+{
+    glGenTextures(1, &this->ID);
+}
+
+Texture2DArray::Texture2DArray(GLuint layers)
+    : ID(0),
+      Width(0),
+      Height(0),
+      Layers(layers),
+      Internal_Format(GL_RGB),
+      Image_Format(GL_RGB),
+      Wrap_S(GL_CLAMP_TO_EDGE),
+      Wrap_T(GL_CLAMP_TO_EDGE),
+      Filter_Min(GL_LINEAR_MIPMAP_LINEAR),
+      Filter_Max(GL_LINEAR)
+{
+}
+
+void Texture2DArray::Generate(GLuint width, GLuint height, GLuint layers, const unsigned char* data)
+{
+    this->Width = width;
+    this->Height = height;
+    this->Layers = layers;
+    // Create Texture
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->ID);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, this->Internal_Format, width, height, layers, 0,
+                 this->Image_Format, GL_UNSIGNED_BYTE, data);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+    // Set Texture wrap and filter modes
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, this->Wrap_S);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, this->Wrap_T);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
+
+    // Unbind texture
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void Texture2DArray::Bind() const
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, this->ID);
+}
@@ -35,3 +35,33 @@ public:
     // Binds the texture as the current active GL_TEXTURE_2D texture object
     void Bind() const;
 };
+
+// Texture2DArray stores equally sized layers in a single GL_TEXTURE_2D_ARRAY
+// object with a full mipmap chain, so sprites can be picked per instance
+// without rebinding.
+class Texture2DArray
+{
+public:
+    // Holds the ID of the texture object
+    GLuint ID;
+    // Layer dimensions in pixels and number of layers
+    GLuint Width, Height, Layers;
+    // Texture Format
+    GLuint Internal_Format; // Format of texture object
+    GLuint Image_Format; // Format of loaded images
+
+    // Texture configuration
+    GLuint Wrap_S; // Wrapping mode on S axis
+    GLuint Wrap_T; // Wrapping mode on T axis
+    GLuint Filter_Min; // Filtering mode if texture pixels < screen pixels
+    GLuint Filter_Max; // Filtering mode if texture pixels > screen pixels
+    // Constructor (sets default texture modes)
+    Texture2DArray();
+    // No texture object, ID stays 0 and no GL call is made. For headless
+    // emitters, which only pick among the layers
+    explicit Texture2DArray(GLuint layers);
+    // Generates texture from tightly packed layer data and builds mipmaps
+    void Generate(GLuint width, GLuint height, GLuint layers, const unsigned char* data);
+    // Binds the texture as the current active GL_TEXTURE_2D_ARRAY texture object
+    void Bind() const;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads executing queued jobs in FIFO order.
+// Used for work that must not block the GL thread (image decoding,
+// simulation passes, ...).
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t nThreads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a job, the returned future yields its result
+    template <typename F>
+    std::future<std::invoke_result_t<F>> Enqueue(F&& job);
+
+    // Splits [begin, end) into one chunk per worker and calls
+    // job(chunkBegin, chunkEnd) for each; the calling thread takes the last
+    // chunk and returns once all are done. Not to be called from a worker
+    template <typename F>
+    void ParallelFor(size_t begin, size_t end, F&& job);
+
+    size_t Size() const { return m_workers.size(); }
+
+    // Process-wide pool shared by all subsystems
+    static ThreadPool& Instance();
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop;
+};
+
+template <typename F>
+std::future<std::invoke_result_t<F>> ThreadPool::Enqueue(F&& job)
+{
+    using Result = std::invoke_result_t<F>;
+    // std::function needs a copyable target, packaged_task is move-only
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    std::future<Result> result = task->get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.emplace([task]() { (*task)(); });
+    }
+    m_condition.notify_one();
+    return result;
+}
+
+template <typename F>
+void ThreadPool::ParallelFor(size_t begin, size_t end, F&& job)
+{
+    if (begin >= end) {
+        return;
+    }
+    const size_t nChunks = std::min(end - begin, m_workers.size() + 1);
+    const size_t chunkSize = (end - begin + nChunks - 1) / nChunks;
+
+    std::vector<std::future<void>> chunks;
+    chunks.reserve(nChunks);
+    size_t chunkBegin = begin;
+    for (; chunkBegin + chunkSize < end; chunkBegin += chunkSize) {
+        const size_t chunkEnd = chunkBegin + chunkSize;
+        chunks.push_back(Enqueue([&job, chunkBegin, chunkEnd]() { job(chunkBegin, chunkEnd); }));
+    }
+    job(chunkBegin, end);
+    for (auto& chunk : chunks) {
+        chunk.get();
+    }
+}